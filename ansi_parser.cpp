@@ -0,0 +1,517 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#include "ansi_parser.hpp"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+
+
+namespace
+{
+
+// Longer parameter lists are cut off, they can't be valid anyway
+constexpr auto maxParametersLength = std::size_t{64};
+
+constexpr auto maxParameterCount = std::size_t{32};
+
+
+// Standard colors 0-15, chosen to be readable on a dark background
+constexpr std::array<std::uint32_t, 16> basicColors{
+  IM_COL32(0, 0, 0, 255),
+  IM_COL32(205, 49, 49, 255),
+  IM_COL32(13, 188, 121, 255),
+  IM_COL32(229, 229, 16, 255),
+  IM_COL32(36, 114, 200, 255),
+  IM_COL32(188, 63, 188, 255),
+  IM_COL32(17, 168, 205, 255),
+  IM_COL32(229, 229, 229, 255),
+  IM_COL32(102, 102, 102, 255),
+  IM_COL32(241, 76, 76, 255),
+  IM_COL32(35, 209, 139, 255),
+  IM_COL32(245, 245, 67, 255),
+  IM_COL32(59, 142, 234, 255),
+  IM_COL32(214, 112, 214, 255),
+  IM_COL32(41, 184, 219, 255),
+  IM_COL32(255, 255, 255, 255),
+};
+
+
+std::uint32_t paletteColor(const int index)
+{
+  if (index < 16)
+  {
+    return basicColors[index];
+  }
+
+  // A 6x6x6 color cube, followed by a ramp of 24 shades of grey
+  if (index < 232)
+  {
+    const auto level = [](const int value)
+    {
+      return value == 0 ? 0 : 55 + value * 40;
+    };
+
+    const auto cubeIndex = index - 16;
+    return IM_COL32(
+      level(cubeIndex / 36), level(cubeIndex / 6 % 6), level(cubeIndex % 6), 255);
+  }
+
+  const auto grey = 8 + (index - 232) * 10;
+  return IM_COL32(grey, grey, grey, 255);
+}
+
+
+// Parses parameters separated by ';' or ':', missing ones count as 0.
+// Returns the number of parameters.
+std::size_t parseParameters(
+  const std::string_view text,
+  std::array<int, maxParameterCount>& values)
+{
+  auto count = std::size_t{0};
+  auto value = 0;
+  for (const auto c : text)
+  {
+    if (c == ';' || c == ':')
+    {
+      if (count < values.size())
+      {
+        values[count++] = value;
+      }
+
+      value = 0;
+    }
+    else if (c >= '0' && c <= '9')
+    {
+      value = std::min(value * 10 + (c - '0'), 0xFFFF);
+    }
+  }
+
+  if (count < values.size())
+  {
+    values[count++] = value;
+  }
+
+  return count;
+}
+
+
+bool isContinuationByte(const char c)
+{
+  return (std::uint8_t(c) & 0xC0) == 0x80;
+}
+
+
+// Number of characters before the given byte position. Positions beyond
+// the end of the line count as blanks.
+std::size_t columnAt(const std::string_view line, const std::size_t position)
+{
+  const auto end = std::min(position, line.size());
+  const auto characters = std::count_if(
+    line.begin(), line.begin() + end, [](const char c)
+    {
+      return !isContinuationByte(c);
+    });
+  return characters + (position - end);
+}
+
+
+// Byte position of the given character, the reverse of columnAt()
+std::size_t positionOfColumn(const std::string_view line, std::size_t column)
+{
+  auto position = std::size_t{0};
+  while (column > 0 && position < line.size())
+  {
+    ++position;
+    while (position < line.size() && isContinuationByte(line[position]))
+    {
+      ++position;
+    }
+
+    --column;
+  }
+
+  return position + column;
+}
+
+}
+
+
+AnsiParser::AnsiParser(TextBuffer& text, const std::uint8_t lineFlags)
+  : mpText(&text)
+  , mLineFlags(lineFlags)
+{
+}
+
+
+AnsiParser::AnsiParser(TextBuffer& text, const AnsiParser& state)
+  : AnsiParser(state)
+{
+  mpText = &text;
+}
+
+
+void AnsiParser::parse(const std::string_view data)
+{
+  // Characters which need special treatment are rare in most output, so
+  // we look for each of them via memchr(), which is a lot faster than
+  // checking every character. Each one is only searched for again once
+  // we have moved past the previous occurrence.
+  const auto findNext = [&](const char c, const std::size_t from)
+  {
+    const auto pFound = std::memchr(data.data() + from, c, data.size() - from);
+    return pFound
+      ? std::size_t(static_cast<const char*>(pFound) - data.data())
+      : data.size();
+  };
+
+  auto nextEscape = findNext('\x1b', 0);
+  auto nextCarriageReturn = findNext('\r', 0);
+  auto nextBackspace = findNext('\b', 0);
+
+  auto position = std::size_t{0};
+  while (position < data.size())
+  {
+    if (mState == State::Text)
+    {
+      if (nextEscape < position)
+      {
+        nextEscape = findNext('\x1b', position);
+      }
+
+      if (nextCarriageReturn < position)
+      {
+        nextCarriageReturn = findNext('\r', position);
+      }
+
+      if (nextBackspace < position)
+      {
+        nextBackspace = findNext('\b', position);
+      }
+
+      // Plain text goes into the buffer in one piece
+      const auto end = std::min({nextEscape, nextCarriageReturn, nextBackspace});
+      writeText(data.substr(position, end - position));
+      position = end;
+      if (position == data.size())
+      {
+        break;
+      }
+    }
+
+    const auto c = data[position++];
+
+    switch (mState)
+    {
+      case State::Text:
+        if (c == '\x1b')
+        {
+          mState = State::Escape;
+        }
+        else if (c == '\r')
+        {
+          moveCursorTo(0);
+        }
+        else
+        {
+          const auto position = cursorPosition();
+          const auto line = mpText->lastLineComplete()
+            ? std::string_view{}
+            : mpText->line(mpText->endLine() - 1);
+          const auto column = columnAt(line, position);
+          moveCursorTo(positionOfColumn(line, column > 0 ? column - 1 : 0));
+        }
+        break;
+
+      case State::Escape:
+        if (c == '[')
+        {
+          mParameters.clear();
+          mState = State::ControlSequence;
+        }
+        else if (c == ']' || c == 'P' || c == 'X' || c == '^' || c == '_')
+        {
+          mState = State::String;
+        }
+        else if (c >= 0x20 && c <= 0x2F)
+        {
+          mState = State::EscapeIntermediate;
+        }
+        else
+        {
+          mState = State::Text;
+        }
+        break;
+
+      case State::EscapeIntermediate:
+        if (c >= 0x30)
+        {
+          mState = State::Text;
+        }
+        break;
+
+      case State::ControlSequence:
+        if (c >= 0x40 && c <= 0x7E)
+        {
+          executeControlSequence(c);
+          mState = State::Text;
+        }
+        else if (mParameters.size() < maxParametersLength)
+        {
+          mParameters += c;
+        }
+        break;
+
+      // Strings (like window titles) end with BEL or ESC backslash
+      case State::String:
+        if (c == '\x07')
+        {
+          mState = State::Text;
+        }
+        else if (c == '\x1b')
+        {
+          mState = State::StringEscape;
+        }
+        break;
+
+      case State::StringEscape:
+        mState = c == '\\' ? State::Text : State::String;
+        break;
+    }
+  }
+}
+
+
+void AnsiParser::writeText(const std::string_view text)
+{
+  if (text.empty())
+  {
+    return;
+  }
+
+  const auto position = cursorPosition();
+  if (!mCursor)
+  {
+    mpText->append(text, mLineFlags, mColor);
+    return;
+  }
+
+  // Overwriting only ever affects the current line, a line break ends it
+  const auto lineEnd = text.find('\n');
+  const auto part = text.substr(0, lineEnd);
+  mpText->write(position, part, mLineFlags, mColor);
+  mCursor = position + part.size();
+
+  if (lineEnd != std::string_view::npos)
+  {
+    mCursor.reset();
+    mpText->append(text.substr(lineEnd), mLineFlags, mColor);
+  }
+}
+
+
+void AnsiParser::moveCursorTo(const std::size_t position)
+{
+  mCursor = position;
+  mCursorLine =
+    mpText->lastLineComplete() ? mpText->endLine() : mpText->endLine() - 1;
+}
+
+
+std::size_t AnsiParser::cursorPosition()
+{
+  const auto lineComplete = mpText->lastLineComplete();
+  const auto currentLine =
+    lineComplete ? mpText->endLine() : mpText->endLine() - 1;
+  const auto lineSize =
+    lineComplete ? std::size_t{0} : mpText->line(currentLine).size();
+
+  // Once another line has started (e.g. due to output on stderr), or the
+  // cursor is at the end, text is simply appended again
+  if (mCursor && mCursorLine == currentLine && *mCursor != lineSize)
+  {
+    return *mCursor;
+  }
+
+  mCursor.reset();
+  return lineSize;
+}
+
+
+void AnsiParser::executeControlSequence(const char command)
+{
+  // Private sequences (e.g. showing/hiding the cursor) are of no interest
+  if (!mParameters.empty() && mParameters.front() >= 0x3C)
+  {
+    return;
+  }
+
+  switch (command)
+  {
+    case 'm':
+      selectGraphicRendition();
+      break;
+
+    case 'K':
+      eraseInLine(mParameters.empty() ? 0 : std::atoi(mParameters.c_str()));
+      break;
+
+    // Cursor horizontal absolute, some progress bars use this instead of
+    // a carriage return
+    case 'G':
+      {
+        const auto column = std::max(std::atoi(mParameters.c_str()), 1) - 1;
+        const auto line = mpText->lastLineComplete()
+          ? std::string_view{}
+          : mpText->line(mpText->endLine() - 1);
+        moveCursorTo(positionOfColumn(line, std::size_t(column)));
+      }
+      break;
+
+    // Moving the cursor to other lines is not supported, since lines
+    // which are complete are never modified
+    default:
+      break;
+  }
+}
+
+
+void AnsiParser::selectGraphicRendition()
+{
+  auto values = std::array<int, maxParameterCount>{};
+  const auto count = parseParameters(mParameters, values);
+
+  for (auto i = std::size_t{0}; i < count; ++i)
+  {
+    const auto value = values[i];
+    if (value == 0)
+    {
+      mPaletteColor = -1;
+      mRgbColor = TextBuffer::defaultColor;
+      mBold = false;
+    }
+    else if (value == 1)
+    {
+      mBold = true;
+    }
+    else if (value == 22)
+    {
+      mBold = false;
+    }
+    else if (value >= 30 && value <= 37)
+    {
+      mPaletteColor = value - 30;
+    }
+    else if (value >= 90 && value <= 97)
+    {
+      mPaletteColor = value - 90 + 8;
+    }
+    else if (value == 39)
+    {
+      mPaletteColor = -1;
+      mRgbColor = TextBuffer::defaultColor;
+    }
+    else if (value == 38 || value == 48)
+    {
+      // Extended colors: 5;n selects from the 256 color palette, 2;r;g;b
+      // gives the color directly. Background colors are skipped.
+      const auto isForeground = value == 38;
+      if (i + 2 < count && values[i + 1] == 5)
+      {
+        if (isForeground)
+        {
+          mPaletteColor = std::min(values[i + 2], 255);
+        }
+
+        i += 2;
+      }
+      else if (i + 4 < count && values[i + 1] == 2)
+      {
+        if (isForeground)
+        {
+          mPaletteColor = -1;
+          mRgbColor = IM_COL32(
+            std::min(values[i + 2], 255),
+            std::min(values[i + 3], 255),
+            std::min(values[i + 4], 255),
+            255);
+        }
+
+        i += 4;
+      }
+      else
+      {
+        break;
+      }
+    }
+  }
+
+  updateColor();
+}
+
+
+void AnsiParser::eraseInLine(const int mode)
+{
+  if (mpText->lastLineComplete())
+  {
+    return;
+  }
+
+  const auto position = cursorPosition();
+  const auto column = columnAt(mpText->line(mpText->endLine() - 1), position);
+
+  if (mode == 0)
+  {
+    mpText->truncateLastLine(position);
+  }
+  else if (mode == 1)
+  {
+    // This includes the character at the cursor
+    mpText->write(
+      0, std::string(column + 1, ' '), mLineFlags, TextBuffer::defaultColor);
+    moveCursorTo(column);
+  }
+  else if (mode == 2)
+  {
+    mpText->truncateLastLine(0);
+    moveCursorTo(column);
+  }
+}
+
+
+void AnsiParser::updateColor()
+{
+  if (mPaletteColor < 0)
+  {
+    mColor = mRgbColor;
+    return;
+  }
+
+  // Like most terminals, we show bold text in the bright variant of the
+  // standard colors
+  const auto index =
+    mBold && mPaletteColor < 8 ? mPaletteColor + 8 : mPaletteColor;
+  mColor = paletteColor(index);
+}
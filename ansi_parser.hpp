@@ -0,0 +1,90 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#pragma once
+
+#include "text_buffer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+
+// Turns output meant for a terminal into text for a TextBuffer.
+//
+// Escape sequences which set the text color (SGR) become color spans in
+// the buffer, all other escape sequences are removed. A carriage return
+// moves back to the start of the line, and the following text overwrites
+// it like it would on a terminal. A progress bar redrawing its line over
+// and over therefore doesn't add any new text.
+//
+// Data can be passed in in arbitrary pieces, escape sequences which are
+// split across them are handled. Every source of output needs its own
+// parser (e.g. one for stdout and one for stderr), since each keeps track
+// of its own color.
+class AnsiParser {
+public:
+  // The given line flags are added to all lines receiving text
+  AnsiParser(TextBuffer& text, std::uint8_t lineFlags);
+
+  // Continues where the given parser left off, but puts the text into
+  // another buffer
+  AnsiParser(TextBuffer& text, const AnsiParser& state);
+
+  void parse(std::string_view data);
+
+private:
+  enum class State
+  {
+    Text,
+    Escape,
+    EscapeIntermediate,
+    ControlSequence,
+    String,
+    StringEscape
+  };
+
+  void writeText(std::string_view text);
+  void moveCursorTo(std::size_t position);
+  std::size_t cursorPosition();
+  void executeControlSequence(char command);
+  void selectGraphicRendition();
+  void eraseInLine(int mode);
+  void updateColor();
+
+  TextBuffer* mpText;
+  std::uint8_t mLineFlags;
+  State mState = State::Text;
+  std::string mParameters;
+
+  // Position within the last line where text goes next, if it's not the
+  // end of the line
+  std::optional<std::size_t> mCursor;
+  std::size_t mCursorLine = 0;
+
+  // Index into the 256 color palette, or -1 to use mRgbColor
+  int mPaletteColor = -1;
+  std::uint32_t mRgbColor = TextBuffer::defaultColor;
+  bool mBold = false;
+  std::uint32_t mColor = TextBuffer::defaultColor;
+};
@@ -0,0 +1,176 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#include "child_process.hpp"
+
+#include <fcntl.h>
+#include <pty.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <stdexcept>
+
+
+extern char** environ;
+
+
+namespace
+{
+
+// Programs asking for the size of the terminal get this
+constexpr auto pseudoterminalColumns = 80;
+constexpr auto pseudoterminalRows = 24;
+
+
+// Creates a channel for one of the program's outputs. The first
+// descriptor is the end we read from, the second one the end handed to
+// the program. Both are close-on-exec, so that the program only ends up
+// with the copies made by dup2() when spawning it.
+void createOutputChannel(int fds[2], const bool usePseudoterminal)
+{
+  if (!usePseudoterminal)
+  {
+    if (pipe2(fds, O_CLOEXEC) == -1)
+    {
+      throw std::runtime_error("Failed to create output pipe");
+    }
+
+    return;
+  }
+
+  winsize windowSize{};
+  windowSize.ws_col = pseudoterminalColumns;
+  windowSize.ws_row = pseudoterminalRows;
+  if (openpty(&fds[0], &fds[1], nullptr, nullptr, &windowSize) == -1)
+  {
+    throw std::runtime_error("Failed to create pseudoterminal");
+  }
+
+  // In raw mode, the terminal passes output through unmodified, instead
+  // of e.g. turning line breaks into \r\n
+  termios attributes;
+  auto configured = tcgetattr(fds[1], &attributes) == 0;
+  if (configured)
+  {
+    cfmakeraw(&attributes);
+    configured =
+      tcsetattr(fds[1], TCSANOW, &attributes) == 0 &&
+      fcntl(fds[0], F_SETFD, FD_CLOEXEC) == 0 &&
+      fcntl(fds[1], F_SETFD, FD_CLOEXEC) == 0;
+  }
+
+  if (!configured)
+  {
+    close(fds[0]);
+    close(fds[1]);
+    throw std::runtime_error("Failed to set up pseudoterminal");
+  }
+}
+
+}
+
+
+ChildProcess::ChildProcess(
+  const std::vector<std::string>& args,
+  const bool usePseudoterminal)
+  : mPid(-1)
+  , mStdoutFd(-1)
+  , mStderrFd(-1)
+{
+  if (args.empty())
+  {
+    throw std::invalid_argument("No program given");
+  }
+
+  std::vector<char*> argv;
+  for (const auto& arg : args)
+  {
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  int stdoutChannel[2];
+  int stderrChannel[2];
+  createOutputChannel(stdoutChannel, usePseudoterminal);
+  try
+  {
+    createOutputChannel(stderrChannel, false);
+  }
+  catch (const std::runtime_error&)
+  {
+    close(stdoutChannel[0]);
+    close(stdoutChannel[1]);
+    throw;
+  }
+
+  posix_spawn_file_actions_t fileActions;
+  posix_spawn_file_actions_init(&fileActions);
+  posix_spawn_file_actions_adddup2(&fileActions, stdoutChannel[1], STDOUT_FILENO);
+  posix_spawn_file_actions_adddup2(&fileActions, stderrChannel[1], STDERR_FILENO);
+
+  auto result = posix_spawnp(
+    &mPid, argv[0], &fileActions, nullptr, argv.data(), environ);
+
+  // Files the kernel can't execute, i.e. scripts without a #! line, are
+  // run by /bin/sh instead. execvp() and popen() do this, but glibc's
+  // posix_spawnp() doesn't.
+  if (result == ENOEXEC)
+  {
+    auto shellArgv = std::vector<char*>{const_cast<char*>("/bin/sh")};
+    shellArgv.insert(shellArgv.end(), argv.begin(), argv.end());
+    result = posix_spawn(
+      &mPid, shellArgv[0], &fileActions, nullptr, shellArgv.data(), environ);
+  }
+
+  posix_spawn_file_actions_destroy(&fileActions);
+
+  // Only the child writes into the channels. Keeping our copies of their
+  // ends open would prevent us from seeing the end of the output.
+  close(stdoutChannel[1]);
+  close(stderrChannel[1]);
+
+  if (result != 0)
+  {
+    close(stdoutChannel[0]);
+    close(stderrChannel[0]);
+    throw std::runtime_error("Failed to execute script");
+  }
+
+  mStdoutFd = stdoutChannel[0];
+  mStderrFd = stderrChannel[0];
+}
+
+
+ChildProcess::~ChildProcess()
+{
+  // Like pclose(): If the program is still running, closing our ends
+  // makes its next write fail, so that it can terminate
+  close(mStdoutFd);
+  close(mStderrFd);
+
+  int status;
+  while (waitpid(mPid, &status, 0) == -1 && errno == EINTR)
+  {
+  }
+}
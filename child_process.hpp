@@ -0,0 +1,65 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+
+// Runs a program as a child process, with its stdout and stderr going
+// into separate pipes. Unlike popen(), this doesn't go through /bin/sh:
+// The program is started directly via posix_spawn(), which avoids the
+// cost of starting and running a shell, and saves a process while it's
+// running.
+//
+// The program is searched for in PATH if the name doesn't contain a
+// slash, like the shell would. Like execvp(), files which can't be
+// executed directly, such as scripts without a #! line, are run by
+// /bin/sh. stdin is inherited.
+//
+// Optionally, stdout goes to a pseudoterminal instead of a pipe. Programs
+// using stdio then see a terminal, and flush their output after each line
+// instead of whenever a buffer of several KiB is full. stderr isn't
+// buffered by stdio, so it always goes into a pipe of its own.
+class ChildProcess {
+public:
+  ChildProcess(const std::vector<std::string>& args, bool usePseudoterminal);
+
+  // Closes the pipes, and waits for the process to exit
+  ~ChildProcess();
+
+  ChildProcess(const ChildProcess&) = delete;
+  ChildProcess& operator=(const ChildProcess&) = delete;
+
+  // Read ends of the pipes (or pseudoterminal) receiving the program's
+  // output. Once the program has exited, reading a pseudoterminal fails
+  // with EIO instead of reporting the end of the file.
+  int stdoutFd() const { return mStdoutFd; }
+  int stderrFd() const { return mStderrFd; }
+
+private:
+  pid_t mPid;
+  int mStdoutFd;
+  int mStderrFd;
+};
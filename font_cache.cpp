@@ -0,0 +1,494 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#include "font_cache.hpp"
+
+#include "hash.hpp"
+#include "stats.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+
+namespace
+{
+
+constexpr auto fileMagic = std::uint32_t{0x41465654}; // "TVFA"
+constexpr auto fileVersion = std::uint32_t{1};
+
+
+struct FileHeader
+{
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint64_t key;
+  std::int32_t texWidth;
+  std::int32_t texHeight;
+  std::int32_t fontCount;
+  std::int32_t customRectCount;
+  std::int32_t packIdMouseCursors;
+  std::int32_t packIdLines;
+  ImVec2 texUvWhitePixel;
+  ImVec4 texUvLines[IM_DRAWLIST_TEX_LINES_WIDTH_MAX + 1];
+};
+
+
+struct FontHeader
+{
+  float fontSize;
+  float ascent;
+  float descent;
+  std::int32_t metricsTotalSurface;
+  std::int32_t glyphCount;
+};
+
+
+// Everything that influences the result of building the atlas needs to
+// go into the key
+std::uint64_t computeKey(const ImFontAtlas& atlas)
+{
+  const std::int32_t globalSettings[] = {
+    IMGUI_VERSION_NUM,
+    std::int32_t(sizeof(ImFontGlyph)),
+    std::int32_t(sizeof(ImWchar)),
+    atlas.Flags,
+    atlas.TexDesiredWidth,
+    atlas.TexGlyphPadding,
+    atlas.Fonts.Size,
+    std::int32_t(atlas.FontBuilderFlags)};
+  auto key = hashBytes(globalSettings, sizeof(globalSettings));
+
+  for (const auto& rect : atlas.CustomRects)
+  {
+    const std::int32_t size[] = {rect.Width, rect.Height};
+    key = hashBytes(size, sizeof(size), key);
+  }
+
+  for (const auto& config : atlas.ConfigData)
+  {
+    key = hashBytes(config.FontData, config.FontDataSize, key);
+
+    const float settings[] = {
+      float(config.FontNo),
+      config.SizePixels,
+      float(config.OversampleH),
+      float(config.OversampleV),
+      float(config.PixelSnapH),
+      config.GlyphExtraSpacing.x,
+      config.GlyphExtraSpacing.y,
+      config.GlyphOffset.x,
+      config.GlyphOffset.y,
+      config.GlyphMinAdvanceX,
+      config.GlyphMaxAdvanceX,
+      float(config.MergeMode),
+      float(config.FontBuilderFlags),
+      config.RasterizerMultiply,
+      float(config.EllipsisChar)};
+    key = hashBytes(settings, sizeof(settings), key);
+
+    auto rangeCount = std::size_t{0};
+    if (config.GlyphRanges)
+    {
+      while (config.GlyphRanges[rangeCount] != 0)
+      {
+        ++rangeCount;
+      }
+    }
+    key = hashBytes(config.GlyphRanges, rangeCount * sizeof(ImWchar), key);
+  }
+
+  return key;
+}
+
+
+std::string cacheFilePath(const std::string& cacheDir, const std::uint64_t key)
+{
+  char fileName[64];
+  std::snprintf(
+    fileName,
+    sizeof(fileName),
+    "/font_atlas_%016llx.bin",
+    static_cast<unsigned long long>(key));
+  return cacheDir + fileName;
+}
+
+
+// Reads a T from the given position, and advances the position. Returns
+// false if there is not enough data left.
+template <typename T>
+bool readValue(const unsigned char*& pData, const unsigned char* pEnd, T& value)
+{
+  if (std::size_t(pEnd - pData) < sizeof(T))
+  {
+    return false;
+  }
+
+  std::memcpy(&value, pData, sizeof(T));
+  pData += sizeof(T);
+  return true;
+}
+
+
+// Returns true if there is enough data left for count values of type T,
+// so that a corrupt count read from the file can't make us allocate huge
+// amounts of memory
+template <typename T>
+bool hasRoomFor(
+  const unsigned char* pData,
+  const unsigned char* pEnd,
+  const std::int32_t count)
+{
+  return count >= 0 && std::size_t(count) <= std::size_t(pEnd - pData) / sizeof(T);
+}
+
+
+// Glyphs are used as they are, so a corrupt codepoint would make the
+// font's lookup table huge, and corrupt texture coordinates would read
+// outside of the atlas
+bool isValidGlyph(const ImFontGlyph& glyph)
+{
+  const auto isTexCoord = [](const float value)
+  {
+    return value >= 0.0f && value <= 1.0f;
+  };
+
+  return
+    glyph.Codepoint <= IM_UNICODE_CODEPOINT_MAX &&
+    isTexCoord(glyph.U0) &&
+    isTexCoord(glyph.V0) &&
+    isTexCoord(glyph.U1) &&
+    isTexCoord(glyph.V1);
+}
+
+
+bool loadAtlas(
+  ImFontAtlas& atlas,
+  const std::uint64_t key,
+  const unsigned char* pData,
+  const unsigned char* pEnd)
+{
+  FileHeader header;
+  if (
+    !readValue(pData, pEnd, header) ||
+    header.magic != fileMagic ||
+    header.version != fileVersion ||
+    header.key != key ||
+    header.fontCount != atlas.Fonts.Size ||
+    header.texWidth <= 0 ||
+    header.texHeight <= 0 ||
+    !hasRoomFor<ImFontAtlasCustomRect>(pData, pEnd, header.customRectCount))
+  {
+    return false;
+  }
+
+  std::vector<ImFontAtlasCustomRect> customRects(header.customRectCount);
+  for (auto& rect : customRects)
+  {
+    if (!readValue(pData, pEnd, rect))
+    {
+      return false;
+    }
+
+    rect.Font = nullptr;
+  }
+
+  // Parse everything first, so that we don't leave the atlas in a half
+  // loaded state in case the file turns out to be truncated
+  std::vector<FontHeader> fontHeaders(header.fontCount);
+  std::vector<ImVector<ImFontGlyph>> glyphs(header.fontCount);
+  for (auto i = 0; i < header.fontCount; ++i)
+  {
+    if (
+      !readValue(pData, pEnd, fontHeaders[i]) ||
+      !hasRoomFor<ImFontGlyph>(pData, pEnd, fontHeaders[i].glyphCount))
+    {
+      return false;
+    }
+
+    glyphs[i].resize(fontHeaders[i].glyphCount);
+    for (auto& glyph : glyphs[i])
+    {
+      if (!readValue(pData, pEnd, glyph) || !isValidGlyph(glyph))
+      {
+        return false;
+      }
+    }
+  }
+
+  const auto pixelCount = std::size_t(header.texWidth) * header.texHeight;
+  if (std::size_t(pEnd - pData) != pixelCount)
+  {
+    return false;
+  }
+
+  // Now set up the atlas the same way ImFontAtlas::Build() would
+  atlas.ClearTexData();
+  atlas.TexWidth = header.texWidth;
+  atlas.TexHeight = header.texHeight;
+  atlas.TexUvScale = {1.0f / header.texWidth, 1.0f / header.texHeight};
+  atlas.TexUvWhitePixel = header.texUvWhitePixel;
+  std::memcpy(atlas.TexUvLines, header.texUvLines, sizeof(atlas.TexUvLines));
+  atlas.TexPixelsUseColors = false;
+  atlas.TexPixelsAlpha8 = static_cast<unsigned char*>(IM_ALLOC(pixelCount));
+  std::memcpy(atlas.TexPixelsAlpha8, pData, pixelCount);
+
+  atlas.CustomRects.resize(0);
+  for (const auto& rect : customRects)
+  {
+    atlas.CustomRects.push_back(rect);
+  }
+  atlas.PackIdMouseCursors = header.packIdMouseCursors;
+  atlas.PackIdLines = header.packIdLines;
+
+  for (auto i = 0; i < header.fontCount; ++i)
+  {
+    auto& font = *atlas.Fonts[i];
+    font.ClearOutputData();
+    font.ContainerAtlas = &atlas;
+    font.FontSize = fontHeaders[i].fontSize;
+    font.Ascent = fontHeaders[i].ascent;
+    font.Descent = fontHeaders[i].descent;
+    font.MetricsTotalSurface = fontHeaders[i].metricsTotalSurface;
+    font.Glyphs.swap(glyphs[i]);
+
+    font.ConfigData = nullptr;
+    font.ConfigDataCount = 0;
+    for (auto& config : atlas.ConfigData)
+    {
+      if (config.DstFont == &font)
+      {
+        if (!font.ConfigData)
+        {
+          font.ConfigData = &config;
+        }
+
+        ++font.ConfigDataCount;
+      }
+    }
+
+    font.BuildLookupTable();
+  }
+
+  atlas.TexReady = true;
+  return true;
+}
+
+
+bool tryLoadFromFile(ImFontAtlas& atlas, const std::uint64_t key, const std::string& path)
+{
+  const auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+  {
+    return false;
+  }
+
+  struct stat fileInfo;
+  if (fstat(fd, &fileInfo) == -1 || fileInfo.st_size <= 0)
+  {
+    close(fd);
+    return false;
+  }
+
+  const auto size = std::size_t(fileInfo.st_size);
+  const auto pMapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (pMapping == MAP_FAILED)
+  {
+    return false;
+  }
+
+  const auto pData = static_cast<const unsigned char*>(pMapping);
+  const auto success = loadAtlas(atlas, key, pData, pData + size);
+
+  munmap(pMapping, size);
+  return success;
+}
+
+
+template <typename T>
+void writeValue(std::vector<unsigned char>& buffer, const T& value)
+{
+  const auto pBytes = reinterpret_cast<const unsigned char*>(&value);
+  buffer.insert(buffer.end(), pBytes, pBytes + sizeof(T));
+}
+
+
+void saveToFile(const ImFontAtlas& atlas, const std::uint64_t key, const std::string& path)
+{
+  FileHeader header{};
+  header.magic = fileMagic;
+  header.version = fileVersion;
+  header.key = key;
+  header.texWidth = atlas.TexWidth;
+  header.texHeight = atlas.TexHeight;
+  header.fontCount = atlas.Fonts.Size;
+  header.customRectCount = atlas.CustomRects.Size;
+  header.packIdMouseCursors = atlas.PackIdMouseCursors;
+  header.packIdLines = atlas.PackIdLines;
+  header.texUvWhitePixel = atlas.TexUvWhitePixel;
+  std::memcpy(header.texUvLines, atlas.TexUvLines, sizeof(header.texUvLines));
+
+  std::vector<unsigned char> buffer;
+  writeValue(buffer, header);
+
+  for (const auto& rect : atlas.CustomRects)
+  {
+    writeValue(buffer, rect);
+  }
+
+  for (const auto pFont : atlas.Fonts)
+  {
+    const auto fontHeader = FontHeader{
+      pFont->FontSize,
+      pFont->Ascent,
+      pFont->Descent,
+      pFont->MetricsTotalSurface,
+      pFont->Glyphs.Size};
+    writeValue(buffer, fontHeader);
+
+    for (const auto& glyph : pFont->Glyphs)
+    {
+      writeValue(buffer, glyph);
+    }
+  }
+
+  buffer.insert(
+    buffer.end(),
+    atlas.TexPixelsAlpha8,
+    atlas.TexPixelsAlpha8 + std::size_t(atlas.TexWidth) * atlas.TexHeight);
+
+  // Write to a temporary file first and then rename it, so that a
+  // concurrently starting instance never sees a partially written file
+  const auto tempPath = path + ".tmp" + std::to_string(getpid());
+  const auto fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd == -1)
+  {
+    return;
+  }
+
+  const auto bytesWritten = write(fd, buffer.data(), buffer.size());
+  close(fd);
+
+  if (bytesWritten != ssize_t(buffer.size()) || rename(tempPath.c_str(), path.c_str()) == -1)
+  {
+    unlink(tempPath.c_str());
+  }
+}
+
+
+// Creates the given directory and all its parents, if needed
+bool createDirectories(const std::string& path)
+{
+  for (auto pos = path.find('/', 1); ; pos = path.find('/', pos + 1))
+  {
+    const auto partialPath = path.substr(0, pos);
+    if (mkdir(partialPath.c_str(), 0755) == -1 && errno != EEXIST)
+    {
+      return false;
+    }
+
+    if (pos == std::string::npos)
+    {
+      return true;
+    }
+  }
+}
+
+}
+
+
+std::string cacheDirectory()
+{
+  if (const auto xdgCacheHome = std::getenv("XDG_CACHE_HOME"); xdgCacheHome && *xdgCacheHome)
+  {
+    return std::string{xdgCacheHome} + "/tvtextviewer";
+  }
+
+  if (const auto home = std::getenv("HOME"); home && *home)
+  {
+    return std::string{home} + "/.cache/tvtextviewer";
+  }
+
+  return {};
+}
+
+
+void loadOrBuildFontAtlas(ImFontAtlas& atlas, const std::string& cacheDir)
+{
+  const auto startTime = std::chrono::steady_clock::now();
+  auto recordTime = [&](const bool fromCache)
+  {
+    stats().fontAtlasMs = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - startTime).count();
+    stats().fontAtlasFromCache = fromCache;
+  };
+
+  // Without any fonts, Build() would add the default font on its own.
+  // We need it to be there up front in order to compute the key.
+  if (atlas.Fonts.empty())
+  {
+    atlas.AddFontDefault();
+  }
+
+  // Custom glyph rectangles would refer to fonts by pointer, which we
+  // can't store in a file. We don't use any, so don't bother.
+  auto canCache = !cacheDir.empty();
+  for (const auto& rect : atlas.CustomRects)
+  {
+    canCache = canCache && rect.Font == nullptr;
+  }
+
+  if (!canCache)
+  {
+    atlas.Build();
+    recordTime(false);
+    return;
+  }
+
+  const auto key = computeKey(atlas);
+  const auto path = cacheFilePath(cacheDir, key);
+  if (tryLoadFromFile(atlas, key, path))
+  {
+    recordTime(true);
+    return;
+  }
+
+  atlas.Build();
+  recordTime(false);
+
+  // Failing to write the cache is not a problem, we'll just need to
+  // build the atlas again next time.
+  if (atlas.TexPixelsAlpha8 && createDirectories(cacheDir))
+  {
+    saveToFile(atlas, key, path);
+  }
+}
@@ -0,0 +1,46 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#pragma once
+
+#include "imgui.h"
+
+#include <string>
+
+
+// Returns the directory used for caching data across runs, or an empty
+// string if none could be determined. Follows the XDG base directory
+// spec, i.e. $XDG_CACHE_HOME/tvtextviewer or ~/.cache/tvtextviewer.
+std::string cacheDirectory();
+
+
+// Makes the given font atlas ready for use, by loading it from a cache
+// file in cacheDir if possible. Otherwise, the atlas is built as usual
+// and then written to the cache, to speed up the next run.
+//
+// Rasterizing the atlas takes tens of milliseconds on slow devices,
+// whereas loading it is a single mmap() and copy. Cache files are keyed
+// by the font data, size, glyph ranges and all other build settings, so
+// changing any of these produces a new cache entry.
+//
+// Must be called after adding all fonts, and before the renderer backend
+// creates the font texture.
+void loadOrBuildFontAtlas(ImFontAtlas& atlas, const std::string& cacheDir);
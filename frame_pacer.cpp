@@ -0,0 +1,93 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#include "frame_pacer.hpp"
+
+#include <thread>
+
+
+namespace
+{
+
+// How long before the deadline we stop sleeping and start spinning.
+// Needs to cover the typical scheduling latency on the target devices.
+constexpr auto spinMargin = std::chrono::microseconds(1500);
+
+}
+
+
+FramePacer::FramePacer(const int maxFps)
+  : mFramePeriod(
+      maxFps > 0
+        ? std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / maxFps))
+        : Clock::duration::zero())
+  , mHaveDeadline(false)
+{
+}
+
+
+void FramePacer::waitForNextFrame()
+{
+  if (mFramePeriod == Clock::duration::zero())
+  {
+    return;
+  }
+
+  const auto now = Clock::now();
+  if (!mHaveDeadline)
+  {
+    mNextDeadline = now + mFramePeriod;
+    mHaveDeadline = true;
+    return;
+  }
+
+  if (now < mNextDeadline)
+  {
+    if (mNextDeadline - now > spinMargin)
+    {
+      std::this_thread::sleep_until(mNextDeadline - spinMargin);
+    }
+
+    while (Clock::now() < mNextDeadline)
+    {
+      std::this_thread::yield();
+    }
+  }
+
+  if (now - mNextDeadline < mFramePeriod)
+  {
+    mNextDeadline += mFramePeriod;
+  }
+  else
+  {
+    // We are running late by more than a frame. Don't try to catch up
+    // by rendering several frames in quick succession, just start a new
+    // schedule from here.
+    mNextDeadline = now + mFramePeriod;
+  }
+}
+
+
+void FramePacer::reset()
+{
+  mHaveDeadline = false;
+}
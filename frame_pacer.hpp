@@ -0,0 +1,51 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#pragma once
+
+#include <chrono>
+
+
+// Limits the frame rate to a given maximum.
+//
+// Sleeping alone is too coarse for accurate pacing on most systems (the
+// scheduler might wake us up a few milliseconds late), so we sleep until
+// shortly before the deadline, and then spin for the remainder.
+class FramePacer {
+public:
+  // A maxFps of 0 disables the limit
+  explicit FramePacer(int maxFps);
+
+  // Blocks until it's time to start the next frame
+  void waitForNextFrame();
+
+  // Tells the pacer that we are about to go idle. The next frame
+  // after idling starts immediately instead of waiting for a deadline
+  // based on the last frame before idling.
+  void reset();
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  Clock::duration mFramePeriod;
+  Clock::time_point mNextDeadline;
+  bool mHaveDeadline;
+};
@@ -0,0 +1,421 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#include "glyph_cache.hpp"
+
+#include "stats.hpp"
+
+#include "imgui_internal.h"
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+
+// Dear ImGui compiles its copy of stb_truetype with internal linkage, so
+// we need our own
+#define STBTT_STATIC
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "imstb_truetype.h"
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+#include <GLES2/gl2.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+
+namespace
+{
+
+// Size of a single page reserved in the atlas. Glyph cells are square
+// and sized according to the font size, so the number of cells per page
+// varies.
+constexpr auto pageSize = 256;
+
+// We reserve enough pages to hold at least this many glyphs, which is
+// plenty for a screen full of CJK text.
+constexpr auto minCellCount = 512;
+constexpr auto maxPageCount = 16;
+
+
+template <typename Func>
+void forEachCodepoint(const std::string_view text, Func func)
+{
+  const auto pEnd = text.data() + text.size();
+  for (auto pChar = text.data(); pChar < pEnd; )
+  {
+    // Everything in the ASCII range is covered by the main font
+    if (static_cast<unsigned char>(*pChar) < 0x80)
+    {
+      ++pChar;
+      continue;
+    }
+
+    unsigned int c = 0;
+    pChar += ImTextCharFromUtf8(&c, pChar, pEnd);
+
+    if (c <= IM_UNICODE_CODEPOINT_MAX)
+    {
+      func(static_cast<ImWchar>(c));
+    }
+  }
+}
+
+}
+
+
+GlyphCache::GlyphCache(ImFontAtlas& atlas, const std::string& fontFile)
+  : mAtlas(atlas)
+  , mpFontInfo(std::make_unique<stbtt_fontinfo>())
+{
+  std::ifstream file(fontFile, std::ios::binary);
+  if (!file.is_open())
+  {
+    throw std::runtime_error("Failed to open glyph font " + fontFile);
+  }
+
+  mFontData.assign(
+    std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+
+  const auto offset = stbtt_GetFontOffsetForIndex(mFontData.data(), 0);
+  if (offset < 0 || !stbtt_InitFont(mpFontInfo.get(), mFontData.data(), offset))
+  {
+    throw std::runtime_error("Failed to load glyph font " + fontFile);
+  }
+
+  if (atlas.ConfigData.empty())
+  {
+    throw std::runtime_error("Glyph cache requires a font to be added first");
+  }
+
+  const auto fontSize = atlas.ConfigData[0].SizePixels;
+  mScale = stbtt_ScaleForPixelHeight(mpFontInfo.get(), fontSize);
+
+  // Leave a pixel of space around each glyph, so that filtering doesn't
+  // pick up parts of neighboring glyphs
+  mCellSize = std::min(int(std::ceil(fontSize)) + 2, pageSize);
+  mCellsPerRow = pageSize / mCellSize;
+  mCellsPerPage = mCellsPerRow * mCellsPerRow;
+
+  const auto pageCount = std::clamp(
+    (minCellCount + mCellsPerPage - 1) / mCellsPerPage, 1, maxPageCount);
+  for (auto i = 0; i < pageCount; ++i)
+  {
+    mPageRectIds.push_back(atlas.AddCustomRectRegular(pageSize, pageSize));
+  }
+
+  mCells.resize(pageCount * mCellsPerPage);
+  mScratchBitmap.resize(mCellSize * mCellSize);
+  mScratchUpload.resize(mCellSize * mCellSize);
+}
+
+
+GlyphCache::~GlyphCache() = default;
+
+
+void GlyphCache::initialize()
+{
+  IM_ASSERT(mAtlas.IsBuilt());
+  mpFont = mAtlas.Fonts[0];
+}
+
+
+void GlyphCache::beginFrame()
+{
+  ++mFrame;
+}
+
+
+void GlyphCache::registerText(const std::string_view text)
+{
+  if (!mpFont)
+  {
+    initialize();
+  }
+
+  auto& font = *mpFont;
+  auto added = false;
+
+  forEachCodepoint(text, [&](const ImWchar c)
+  {
+    if (font.FindGlyphNoFallback(c) || !stbtt_FindGlyphIndex(mpFontInfo.get(), c))
+    {
+      return;
+    }
+
+    int advance = 0;
+    int leftSideBearing = 0;
+    stbtt_GetCodepointHMetrics(mpFontInfo.get(), c, &advance, &leftSideBearing);
+
+    int x0 = 0;
+    int y0 = 0;
+    int x1 = 0;
+    int y1 = 0;
+    stbtt_GetCodepointBitmapBox(mpFontInfo.get(), c, mScale, mScale, &x0, &y0, &x1, &y1);
+
+    // Align the glyph's baseline with the one of the main font. Glyphs
+    // larger than a cell get cut off.
+    ImFontGlyph glyph{};
+    glyph.Codepoint = c;
+    glyph.Visible = false;
+    glyph.AdvanceX = IM_ROUND(advance * mScale);
+    glyph.X0 = float(x0);
+    glyph.Y0 = float(y0) + IM_ROUND(font.Ascent);
+    glyph.X1 = float(std::min(x1, x0 + mCellSize - 2));
+    glyph.Y1 = float(std::min(y1, y0 + mCellSize - 2)) + IM_ROUND(font.Ascent);
+
+    mEntries[c] = Entry{font.Glyphs.Size};
+    font.Glyphs.push_back(glyph);
+
+    // The index might have gaps, which need to map to the fallback glyph
+    const auto oldIndexSize = font.IndexAdvanceX.Size;
+    font.GrowIndex(c + 1);
+    for (auto i = oldIndexSize; i < font.IndexAdvanceX.Size; ++i)
+    {
+      font.IndexAdvanceX[i] = font.FallbackAdvanceX;
+    }
+
+    font.IndexAdvanceX[c] = glyph.AdvanceX;
+    font.IndexLookup[c] = ImWchar(font.Glyphs.Size - 1);
+    added = true;
+  });
+
+  // Adding glyphs might have reallocated the glyph array
+  if (added)
+  {
+    font.FallbackGlyph = font.FindGlyphNoFallback(font.FallbackChar);
+  }
+}
+
+
+bool GlyphCache::UsedGlyph::operator<(const UsedGlyph& other) const
+{
+  return codepoint < other.codepoint;
+}
+
+
+bool GlyphCache::UsedGlyph::operator==(const UsedGlyph& other) const
+{
+  return codepoint == other.codepoint && generation == other.generation;
+}
+
+
+bool GlyphCache::makeResident(
+  const std::string_view text,
+  std::vector<UsedGlyph>* pUsedGlyphs)
+{
+  auto success = true;
+
+  forEachCodepoint(text, [&](const ImWchar c)
+  {
+    if (const auto iEntry = mEntries.find(c); iEntry != mEntries.end())
+    {
+      auto& entry = iEntry->second;
+      makeResident(c, entry);
+      success = success && entry.cell != -1;
+
+      if (pUsedGlyphs)
+      {
+        pUsedGlyphs->push_back(
+          {c, entry.cell != -1 ? entry.generation : UsedGlyph::notResident});
+      }
+    }
+  });
+
+  return success;
+}
+
+
+bool GlyphCache::touch(const std::vector<UsedGlyph>& usedGlyphs)
+{
+  auto unchanged = true;
+  for (const auto& usedGlyph : usedGlyphs)
+  {
+    const auto& entry = mEntries.at(usedGlyph.codepoint);
+    if (
+      usedGlyph.generation == UsedGlyph::notResident ||
+      entry.generation != usedGlyph.generation)
+    {
+      unchanged = false;
+    }
+    else if (entry.cell != -1)
+    {
+      mCells[entry.cell].lastUsedFrame = mFrame;
+    }
+  }
+
+  return unchanged;
+}
+
+
+void GlyphCache::makeResident(const ImWchar codepoint, Entry& entry)
+{
+  if (entry.cell != -1)
+  {
+    mCells[entry.cell].lastUsedFrame = mFrame;
+    return;
+  }
+
+  const auto cellIndex = allocateCell();
+  if (cellIndex == -1)
+  {
+    return;
+  }
+
+  auto& cell = mCells[cellIndex];
+  cell.codepoint = codepoint;
+  cell.occupied = true;
+  cell.lastUsedFrame = mFrame;
+
+  entry.cell = cellIndex;
+  entry.generation = mNextGeneration++;
+
+  // Rasterize into the cell, leaving a 1 pixel border
+  auto& glyph = mpFont->Glyphs[entry.glyphIndex];
+  const auto width = int(glyph.X1 - glyph.X0);
+  const auto height = int(glyph.Y1 - glyph.Y0);
+
+  std::fill(mScratchBitmap.begin(), mScratchBitmap.end(), 0);
+  stbtt_MakeCodepointBitmap(
+    mpFontInfo.get(),
+    &mScratchBitmap[mCellSize + 1],
+    width,
+    height,
+    mCellSize,
+    mScale,
+    mScale,
+    codepoint);
+  uploadCell(cellIndex, mScratchBitmap.data());
+
+  const auto pRect = mAtlas.GetCustomRectByIndex(mPageRectIds[cellIndex / mCellsPerPage]);
+  const auto cellInPage = cellIndex % mCellsPerPage;
+  const auto x = pRect->X + (cellInPage % mCellsPerRow) * mCellSize + 1;
+  const auto y = pRect->Y + (cellInPage / mCellsPerRow) * mCellSize + 1;
+
+  glyph.Visible = width > 0 && height > 0;
+  glyph.U0 = x * mAtlas.TexUvScale.x;
+  glyph.V0 = y * mAtlas.TexUvScale.y;
+  glyph.U1 = (x + width) * mAtlas.TexUvScale.x;
+  glyph.V1 = (y + height) * mAtlas.TexUvScale.y;
+
+  ++stats().glyphsRasterized;
+}
+
+
+int GlyphCache::allocateCell()
+{
+  auto leastRecentlyUsed = -1;
+  for (auto i = 0; i < int(mCells.size()); ++i)
+  {
+    if (!mCells[i].occupied)
+    {
+      return i;
+    }
+
+    if (
+      mCells[i].lastUsedFrame != mFrame &&
+      (leastRecentlyUsed == -1 ||
+       mCells[i].lastUsedFrame < mCells[leastRecentlyUsed].lastUsedFrame))
+    {
+      leastRecentlyUsed = i;
+    }
+  }
+
+  if (leastRecentlyUsed == -1)
+  {
+    return -1;
+  }
+
+  // Evict the previous occupant. It keeps its metrics, but doesn't draw
+  // anything until it becomes resident again.
+  auto& evicted = mEntries.at(mCells[leastRecentlyUsed].codepoint);
+  auto& glyph = mpFont->Glyphs[evicted.glyphIndex];
+  glyph.Visible = false;
+  glyph.U0 = glyph.V0 = glyph.U1 = glyph.V1 = 0.0f;
+  evicted.cell = -1;
+  evicted.generation = 0;
+
+  mCells[leastRecentlyUsed].occupied = false;
+  ++stats().glyphsEvicted;
+  return leastRecentlyUsed;
+}
+
+
+void GlyphCache::uploadCell(const int cell, const unsigned char* pPixels)
+{
+  const auto pRect = mAtlas.GetCustomRectByIndex(mPageRectIds[cell / mCellsPerPage]);
+  const auto cellInPage = cell % mCellsPerPage;
+  const auto x = pRect->X + (cellInPage % mCellsPerRow) * mCellSize;
+  const auto y = pRect->Y + (cellInPage / mCellsPerRow) * mCellSize;
+
+  // Keep the CPU side copy of the atlas in sync, in case the texture
+  // needs to be created again
+  for (auto row = 0; row < mCellSize; ++row)
+  {
+    std::copy_n(
+      pPixels + row * mCellSize,
+      mCellSize,
+      mAtlas.TexPixelsAlpha8 + (y + row) * mAtlas.TexWidth + x);
+  }
+
+  glBindTexture(GL_TEXTURE_2D, GLuint(intptr_t(mAtlas.TexID)));
+
+  // The texture is alpha only unless the renderer was asked to use RGBA,
+  // in which case the atlas also has RGBA data.
+  if (!mAtlas.TexPixelsRGBA32)
+  {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(
+      GL_TEXTURE_2D, 0, x, y, mCellSize, mCellSize, GL_ALPHA, GL_UNSIGNED_BYTE, pPixels);
+    return;
+  }
+
+  for (auto i = 0; i < mCellSize * mCellSize; ++i)
+  {
+    mScratchUpload[i] = IM_COL32(255, 255, 255, pPixels[i]);
+  }
+
+  for (auto row = 0; row < mCellSize; ++row)
+  {
+    std::copy_n(
+      &mScratchUpload[row * mCellSize],
+      mCellSize,
+      mAtlas.TexPixelsRGBA32 + (y + row) * mAtlas.TexWidth + x);
+  }
+
+  glTexSubImage2D(
+    GL_TEXTURE_2D,
+    0,
+    x,
+    y,
+    mCellSize,
+    mCellSize,
+    GL_RGBA,
+    GL_UNSIGNED_BYTE,
+    mScratchUpload.data());
+}
@@ -0,0 +1,142 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#pragma once
+
+#include "imgui.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+struct stbtt_fontinfo;
+
+
+// Rasterizes glyphs which are missing from the main font on demand, using
+// a secondary font file (e.g. one covering CJK characters).
+//
+// Baking large glyph ranges into the font atlas up front would take
+// seconds and produce a huge texture. Instead, we reserve a few fixed size
+// pages in the atlas, and rasterize glyphs into free cells of those pages
+// when they are first needed. When all cells are taken, the least
+// recently used glyph is evicted. Only the changed cell is uploaded to
+// the GPU.
+//
+// Glyphs are added to the main font itself, so that text measurement and
+// rendering work without any special handling. This happens in two steps:
+//
+//  * registerText() adds the metrics of all new glyphs in the given text.
+//    This needs to happen before the text is measured, so that layout is
+//    correct no matter if a glyph is currently resident or not. Metrics
+//    are never evicted.
+//  * makeResident() rasterizes glyphs into the texture. This needs to
+//    happen before building vertex data for the text. Non-resident glyphs
+//    are marked as not visible, so they render as blank space.
+class GlyphCache {
+public:
+  // Reserves space in the given atlas, so this must be called before the
+  // atlas is built. Glyphs are added to the first font in the atlas.
+  GlyphCache(ImFontAtlas& atlas, const std::string& fontFile);
+  ~GlyphCache();
+
+  GlyphCache(const GlyphCache&) = delete;
+  GlyphCache& operator=(const GlyphCache&) = delete;
+
+  // Should be called once at the start of each frame. Glyphs used in the
+  // current frame are never evicted.
+  void beginFrame();
+
+  void registerText(std::string_view text);
+
+  // A dynamic glyph used by some piece of vertex data, and its residency
+  // generation at the time the data was built. The generation changes
+  // whenever a glyph becomes resident. Glyphs which couldn't be made
+  // resident are recorded with notResident, so that the data is rebuilt
+  // on a later frame, when there might be space again.
+  struct UsedGlyph
+  {
+    ImWchar codepoint;
+    std::uint64_t generation;
+
+    bool operator<(const UsedGlyph& other) const;
+    bool operator==(const UsedGlyph& other) const;
+
+    static constexpr auto notResident = ~std::uint64_t{0};
+  };
+
+  // Makes all glyphs in text resident and marks them as used in the
+  // current frame. If pUsedGlyphs is given, the dynamic glyphs found in
+  // the text are appended to it. Returns false if there was not enough
+  // space.
+  bool makeResident(
+    std::string_view text,
+    std::vector<UsedGlyph>* pUsedGlyphs = nullptr);
+
+  // Marks the given glyphs as used in the current frame. Returns false if
+  // any of them has been evicted or made resident since the glyphs were
+  // recorded, or if any of them wasn't resident at the time, in which
+  // case vertex data using them needs to be rebuilt.
+  bool touch(const std::vector<UsedGlyph>& usedGlyphs);
+
+private:
+  struct Entry
+  {
+    int glyphIndex;
+    int cell = -1;
+    std::uint64_t generation = 0;
+  };
+
+  struct Cell
+  {
+    ImWchar codepoint = 0;
+    bool occupied = false;
+    std::uint64_t lastUsedFrame = 0;
+  };
+
+  void initialize();
+  void makeResident(ImWchar codepoint, Entry& entry);
+  int allocateCell();
+  void uploadCell(int cell, const unsigned char* pPixels);
+
+  ImFontAtlas& mAtlas;
+  ImFont* mpFont = nullptr;
+
+  std::vector<unsigned char> mFontData;
+  std::unique_ptr<stbtt_fontinfo> mpFontInfo;
+  float mScale = 0.0f;
+
+  std::vector<int> mPageRectIds;
+  int mCellSize = 0;
+  int mCellsPerRow = 0;
+  int mCellsPerPage = 0;
+
+  std::unordered_map<ImWchar, Entry> mEntries;
+  std::vector<Cell> mCells;
+  std::vector<unsigned char> mScratchBitmap;
+  std::vector<ImU32> mScratchUpload;
+
+  std::uint64_t mFrame = 1;
+  std::uint64_t mNextGeneration = 1;
+};
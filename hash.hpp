@@ -0,0 +1,57 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+
+// Mixes the given bytes into a running 64-bit hash. This works on whole
+// words at a time, since it needs to keep up with the amount of vertex
+// data produced by a screen full of text on slow CPUs. Not suitable for
+// anything security related.
+inline std::uint64_t hashBytes(
+  const void* pData,
+  const std::size_t size,
+  std::uint64_t hash = 0)
+{
+  constexpr auto multiplier = std::uint64_t{0x9E3779B97F4A7C15};
+
+  const auto pBytes = static_cast<const unsigned char*>(pData);
+  auto offset = std::size_t{0};
+  for (; offset + sizeof(std::uint64_t) <= size; offset += sizeof(std::uint64_t))
+  {
+    std::uint64_t word;
+    std::memcpy(&word, pBytes + offset, sizeof(word));
+    hash = (hash ^ word) * multiplier;
+    hash ^= hash >> 29;
+  }
+
+  std::uint64_t tail = 0;
+  if (offset < size)
+  {
+    std::memcpy(&tail, pBytes + offset, size - offset);
+  }
+
+  hash = (hash ^ tail ^ size) * multiplier;
+  return hash ^ (hash >> 29);
+}
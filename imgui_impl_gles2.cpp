@@ -0,0 +1,351 @@
+// dear imgui: Renderer Backend for OpenGL ES 2.0, specific to TvTextViewer
+// See imgui_impl_gles2.h for how this differs from imgui_impl_opengl3.cpp.
+
+#include "imgui.h"
+#include "imgui_impl_gles2.h"
+#include <stdio.h>
+#include <string.h>     // memset
+#include <stdint.h>     // intptr_t
+
+#include <GLES2/gl2.h>
+
+// Attribute locations are fixed, so that other renderers sharing the
+// context (see text_renderer.cpp) can use the same ones.
+enum
+{
+    ImGui_ImplGLES2_AttribPosition = 0,
+    ImGui_ImplGLES2_AttribUV = 1,
+    ImGui_ImplGLES2_AttribColor = 2,
+};
+
+// OpenGL Data
+struct ImGui_ImplGLES2_Data
+{
+    GLuint          FontTexture;
+    size_t          FontTextureSize;
+    bool            AlphaOnlyFontTexture;
+    GLuint          ShaderHandle;
+    GLint           UniformLocationTex;
+    GLint           UniformLocationProjMtx;
+    GLuint          VboHandle, ElementsHandle;
+
+    ImGui_ImplGLES2_Data() { memset((void*)this, 0, sizeof(*this)); }
+};
+
+static ImGui_ImplGLES2_Data* ImGui_ImplGLES2_GetBackendData()
+{
+    return ImGui::GetCurrentContext() ? (ImGui_ImplGLES2_Data*)ImGui::GetIO().BackendRendererUserData : NULL;
+}
+
+// Functions
+bool    ImGui_ImplGLES2_Init(bool alpha_only_font_texture)
+{
+    ImGuiIO& io = ImGui::GetIO();
+    IM_ASSERT(io.BackendRendererUserData == NULL && "Already initialized a renderer backend!");
+
+    ImGui_ImplGLES2_Data* bd = IM_NEW(ImGui_ImplGLES2_Data)();
+    bd->AlphaOnlyFontTexture = alpha_only_font_texture;
+    io.BackendRendererUserData = (void*)bd;
+    io.BackendRendererName = "imgui_impl_gles2";
+
+    return true;
+}
+
+void    ImGui_ImplGLES2_Shutdown()
+{
+    ImGui_ImplGLES2_Data* bd = ImGui_ImplGLES2_GetBackendData();
+    IM_ASSERT(bd != NULL && "No renderer backend to shutdown, or already shutdown?");
+    ImGuiIO& io = ImGui::GetIO();
+
+    ImGui_ImplGLES2_DestroyDeviceObjects();
+    io.BackendRendererName = NULL;
+    io.BackendRendererUserData = NULL;
+    IM_DELETE(bd);
+}
+
+void    ImGui_ImplGLES2_NewFrame()
+{
+    ImGui_ImplGLES2_Data* bd = ImGui_ImplGLES2_GetBackendData();
+    IM_ASSERT(bd != NULL && "Did you call ImGui_ImplGLES2_Init()?");
+
+    if (!bd->ShaderHandle)
+        ImGui_ImplGLES2_CreateDeviceObjects();
+}
+
+static void ImGui_ImplGLES2_SetupRenderState(ImDrawData* draw_data, int fb_width, int fb_height)
+{
+    ImGui_ImplGLES2_Data* bd = ImGui_ImplGLES2_GetBackendData();
+
+    // Setup render state: alpha-blending enabled, no face culling, no depth testing, scissor enabled
+    glEnable(GL_BLEND);
+    glBlendEquation(GL_FUNC_ADD);
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_STENCIL_TEST);
+    glEnable(GL_SCISSOR_TEST);
+    glActiveTexture(GL_TEXTURE0);
+
+    // Setup viewport, orthographic projection matrix
+    glViewport(0, 0, (GLsizei)fb_width, (GLsizei)fb_height);
+    float L = draw_data->DisplayPos.x;
+    float R = draw_data->DisplayPos.x + draw_data->DisplaySize.x;
+    float T = draw_data->DisplayPos.y;
+    float B = draw_data->DisplayPos.y + draw_data->DisplaySize.y;
+    const float ortho_projection[4][4] =
+    {
+        { 2.0f/(R-L),   0.0f,         0.0f,   0.0f },
+        { 0.0f,         2.0f/(T-B),   0.0f,   0.0f },
+        { 0.0f,         0.0f,        -1.0f,   0.0f },
+        { (R+L)/(L-R),  (T+B)/(B-T),  0.0f,   1.0f },
+    };
+    glUseProgram(bd->ShaderHandle);
+    glUniform1i(bd->UniformLocationTex, 0);
+    glUniformMatrix4fv(bd->UniformLocationProjMtx, 1, GL_FALSE, &ortho_projection[0][0]);
+
+    // Bind vertex/index buffers and setup attributes for ImDrawVert
+    glBindBuffer(GL_ARRAY_BUFFER, bd->VboHandle);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bd->ElementsHandle);
+    glEnableVertexAttribArray(ImGui_ImplGLES2_AttribPosition);
+    glEnableVertexAttribArray(ImGui_ImplGLES2_AttribUV);
+    glEnableVertexAttribArray(ImGui_ImplGLES2_AttribColor);
+    glVertexAttribPointer(ImGui_ImplGLES2_AttribPosition, 2, GL_FLOAT,         GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, pos));
+    glVertexAttribPointer(ImGui_ImplGLES2_AttribUV,       2, GL_FLOAT,         GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, uv));
+    glVertexAttribPointer(ImGui_ImplGLES2_AttribColor,    4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, col));
+}
+
+void    ImGui_ImplGLES2_RenderDrawData(ImDrawData* draw_data)
+{
+    // Avoid rendering when minimized, scale coordinates for retina displays (screen coordinates != framebuffer coordinates)
+    int fb_width = (int)(draw_data->DisplaySize.x * draw_data->FramebufferScale.x);
+    int fb_height = (int)(draw_data->DisplaySize.y * draw_data->FramebufferScale.y);
+    if (fb_width <= 0 || fb_height <= 0)
+        return;
+
+    ImGui_ImplGLES2_SetupRenderState(draw_data, fb_width, fb_height);
+
+    // Will project scissor/clipping rectangles into framebuffer space
+    ImVec2 clip_off = draw_data->DisplayPos;         // (0,0) unless using multi-viewports
+    ImVec2 clip_scale = draw_data->FramebufferScale; // (1,1) unless using retina display which are often (2,2)
+
+    // Render command lists
+    GLuint last_texture = 0;
+    for (int n = 0; n < draw_data->CmdListsCount; n++)
+    {
+        const ImDrawList* cmd_list = draw_data->CmdLists[n];
+
+        // Upload vertex/index buffers
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmd_list->VtxBuffer.Size * (int)sizeof(ImDrawVert), (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmd_list->IdxBuffer.Size * (int)sizeof(ImDrawIdx), (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW);
+
+        for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
+        {
+            const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
+            if (pcmd->UserCallback != NULL)
+            {
+                // User callback, registered via ImDrawList::AddCallback()
+                // (ImDrawCallback_ResetRenderState is a special callback value used by the user to request the renderer to reset render state.)
+                if (pcmd->UserCallback == ImDrawCallback_ResetRenderState)
+                    ImGui_ImplGLES2_SetupRenderState(draw_data, fb_width, fb_height);
+                else
+                    pcmd->UserCallback(cmd_list, pcmd);
+
+                // The callback might have bound a different texture
+                last_texture = 0;
+            }
+            else
+            {
+                // Project scissor/clipping rectangles into framebuffer space
+                ImVec2 clip_min((pcmd->ClipRect.x - clip_off.x) * clip_scale.x, (pcmd->ClipRect.y - clip_off.y) * clip_scale.y);
+                ImVec2 clip_max((pcmd->ClipRect.z - clip_off.x) * clip_scale.x, (pcmd->ClipRect.w - clip_off.y) * clip_scale.y);
+                if (clip_max.x <= clip_min.x || clip_max.y <= clip_min.y)
+                    continue;
+
+                // Apply scissor/clipping rectangle (Y is inverted in OpenGL)
+                glScissor((int)clip_min.x, (int)((float)fb_height - clip_max.y), (int)(clip_max.x - clip_min.x), (int)(clip_max.y - clip_min.y));
+
+                // Bind texture, Draw. Almost everything uses the font texture, so avoid redundant binds.
+                GLuint texture = (GLuint)(intptr_t)pcmd->GetTexID();
+                if (texture != last_texture)
+                {
+                    glBindTexture(GL_TEXTURE_2D, texture);
+                    last_texture = texture;
+                }
+                glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(intptr_t)(pcmd->IdxOffset * sizeof(ImDrawIdx)));
+            }
+        }
+    }
+}
+
+bool ImGui_ImplGLES2_CreateFontsTexture()
+{
+    ImGuiIO& io = ImGui::GetIO();
+    ImGui_ImplGLES2_Data* bd = ImGui_ImplGLES2_GetBackendData();
+
+    // Build texture atlas. The shader only looks at the alpha channel, and
+    // the RGB part of the RGBA data is all white, so both formats render the same.
+    unsigned char* pixels;
+    int width, height;
+    GLenum format;
+    size_t bytes_per_pixel;
+    if (bd->AlphaOnlyFontTexture)
+    {
+        io.Fonts->GetTexDataAsAlpha8(&pixels, &width, &height);
+        format = GL_ALPHA;
+        bytes_per_pixel = 1;
+    }
+    else
+    {
+        io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+        format = GL_RGBA;
+        bytes_per_pixel = 4;
+    }
+
+    // Upload texture to graphics system
+    // (Bilinear sampling is required by default. Set 'io.Fonts->Flags |= ImFontAtlasFlags_NoBakedLines' or 'style.AntiAliasedLinesUseTex = false' to allow point/nearest sampling)
+    glGenTextures(1, &bd->FontTexture);
+    glBindTexture(GL_TEXTURE_2D, bd->FontTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+    bd->FontTextureSize = (size_t)width * height * bytes_per_pixel;
+
+    // Store our identifier
+    io.Fonts->SetTexID((ImTextureID)(intptr_t)bd->FontTexture);
+
+    return true;
+}
+
+void ImGui_ImplGLES2_DestroyFontsTexture()
+{
+    ImGuiIO& io = ImGui::GetIO();
+    ImGui_ImplGLES2_Data* bd = ImGui_ImplGLES2_GetBackendData();
+    if (bd->FontTexture)
+    {
+        glDeleteTextures(1, &bd->FontTexture);
+        io.Fonts->SetTexID(0);
+        bd->FontTexture = 0;
+        bd->FontTextureSize = 0;
+    }
+}
+
+size_t ImGui_ImplGLES2_GetFontTextureSize()
+{
+    ImGui_ImplGLES2_Data* bd = ImGui_ImplGLES2_GetBackendData();
+    return bd ? bd->FontTextureSize : 0;
+}
+
+static bool CheckShader(GLuint handle, const char* desc)
+{
+    GLint status = 0, log_length = 0;
+    glGetShaderiv(handle, GL_COMPILE_STATUS, &status);
+    glGetShaderiv(handle, GL_INFO_LOG_LENGTH, &log_length);
+    if ((GLboolean)status == GL_FALSE)
+        fprintf(stderr, "ERROR: ImGui_ImplGLES2_CreateDeviceObjects: failed to compile %s!\n", desc);
+    if (log_length > 1)
+    {
+        ImVector<char> buf;
+        buf.resize((int)(log_length + 1));
+        glGetShaderInfoLog(handle, log_length, NULL, (GLchar*)buf.begin());
+        fprintf(stderr, "%s\n", buf.begin());
+    }
+    return (GLboolean)status == GL_TRUE;
+}
+
+static bool CheckProgram(GLuint handle, const char* desc)
+{
+    GLint status = 0, log_length = 0;
+    glGetProgramiv(handle, GL_LINK_STATUS, &status);
+    glGetProgramiv(handle, GL_INFO_LOG_LENGTH, &log_length);
+    if ((GLboolean)status == GL_FALSE)
+        fprintf(stderr, "ERROR: ImGui_ImplGLES2_CreateDeviceObjects: failed to link %s!\n", desc);
+    if (log_length > 1)
+    {
+        ImVector<char> buf;
+        buf.resize((int)(log_length + 1));
+        glGetProgramInfoLog(handle, log_length, NULL, (GLchar*)buf.begin());
+        fprintf(stderr, "%s\n", buf.begin());
+    }
+    return (GLboolean)status == GL_TRUE;
+}
+
+bool    ImGui_ImplGLES2_CreateDeviceObjects()
+{
+    ImGui_ImplGLES2_Data* bd = ImGui_ImplGLES2_GetBackendData();
+
+    const GLchar* vertex_shader =
+        "#version 100\n"
+        "uniform mat4 ProjMtx;\n"
+        "attribute vec2 Position;\n"
+        "attribute vec2 UV;\n"
+        "attribute vec4 Color;\n"
+        "varying vec2 Frag_UV;\n"
+        "varying vec4 Frag_Color;\n"
+        "void main()\n"
+        "{\n"
+        "    Frag_UV = UV;\n"
+        "    Frag_Color = Color;\n"
+        "    gl_Position = ProjMtx * vec4(Position.xy,0,1);\n"
+        "}\n";
+
+    // Only the alpha channel of the texture is used, see CreateFontsTexture()
+    const GLchar* fragment_shader =
+        "#version 100\n"
+        "precision mediump float;\n"
+        "uniform sampler2D Texture;\n"
+        "varying vec2 Frag_UV;\n"
+        "varying vec4 Frag_Color;\n"
+        "void main()\n"
+        "{\n"
+        "    gl_FragColor = vec4(Frag_Color.rgb, Frag_Color.a * texture2D(Texture, Frag_UV.st).a);\n"
+        "}\n";
+
+    // Create shaders
+    GLuint vert_handle = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vert_handle, 1, &vertex_shader, NULL);
+    glCompileShader(vert_handle);
+    CheckShader(vert_handle, "vertex shader");
+
+    GLuint frag_handle = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(frag_handle, 1, &fragment_shader, NULL);
+    glCompileShader(frag_handle);
+    CheckShader(frag_handle, "fragment shader");
+
+    // Link
+    bd->ShaderHandle = glCreateProgram();
+    glAttachShader(bd->ShaderHandle, vert_handle);
+    glAttachShader(bd->ShaderHandle, frag_handle);
+    glBindAttribLocation(bd->ShaderHandle, ImGui_ImplGLES2_AttribPosition, "Position");
+    glBindAttribLocation(bd->ShaderHandle, ImGui_ImplGLES2_AttribUV, "UV");
+    glBindAttribLocation(bd->ShaderHandle, ImGui_ImplGLES2_AttribColor, "Color");
+    glLinkProgram(bd->ShaderHandle);
+    CheckProgram(bd->ShaderHandle, "shader program");
+
+    glDetachShader(bd->ShaderHandle, vert_handle);
+    glDetachShader(bd->ShaderHandle, frag_handle);
+    glDeleteShader(vert_handle);
+    glDeleteShader(frag_handle);
+
+    bd->UniformLocationTex = glGetUniformLocation(bd->ShaderHandle, "Texture");
+    bd->UniformLocationProjMtx = glGetUniformLocation(bd->ShaderHandle, "ProjMtx");
+
+    // Create buffers
+    glGenBuffers(1, &bd->VboHandle);
+    glGenBuffers(1, &bd->ElementsHandle);
+
+    ImGui_ImplGLES2_CreateFontsTexture();
+
+    return true;
+}
+
+void    ImGui_ImplGLES2_DestroyDeviceObjects()
+{
+    ImGui_ImplGLES2_Data* bd = ImGui_ImplGLES2_GetBackendData();
+    if (bd->VboHandle)      { glDeleteBuffers(1, &bd->VboHandle); bd->VboHandle = 0; }
+    if (bd->ElementsHandle) { glDeleteBuffers(1, &bd->ElementsHandle); bd->ElementsHandle = 0; }
+    if (bd->ShaderHandle)   { glDeleteProgram(bd->ShaderHandle); bd->ShaderHandle = 0; }
+    ImGui_ImplGLES2_DestroyFontsTexture();
+}
@@ -0,0 +1,33 @@
+// dear imgui: Renderer Backend for OpenGL ES 2.0, specific to TvTextViewer
+// Derived from imgui_impl_opengl3.cpp, but stripped down to what we need:
+// - OpenGL ES 2.0 only, no loader, no VAOs.
+// - The font atlas is uploaded as a single channel GL_ALPHA texture instead
+//   of RGBA, which cuts its memory footprint and the bandwidth needed for
+//   sampling it to a quarter. Use ImGui_ImplGLES2_Init(false) to get the
+//   RGBA behavior of the upstream backend, e.g. for comparison.
+// - GL state is not backed up and restored around rendering, since we own
+//   the whole GL context. Querying state can stall on some mobile drivers.
+
+// Implemented features:
+//  [X] Renderer: Font atlas as GL_ALPHA or GL_RGBA texture.
+// Missing features:
+//  [ ] Renderer: User textures. The shader only uses the texture's alpha
+//      channel, so only textures containing coverage data can be drawn.
+//  [ ] Renderer: Large meshes (64k+ vertices) with 16-bit indices.
+
+#pragma once
+#include "imgui.h"      // IMGUI_IMPL_API
+
+IMGUI_IMPL_API bool     ImGui_ImplGLES2_Init(bool alpha_only_font_texture = true);
+IMGUI_IMPL_API void     ImGui_ImplGLES2_Shutdown();
+IMGUI_IMPL_API void     ImGui_ImplGLES2_NewFrame();
+IMGUI_IMPL_API void     ImGui_ImplGLES2_RenderDrawData(ImDrawData* draw_data);
+
+// Called by Init/NewFrame/Shutdown
+IMGUI_IMPL_API bool     ImGui_ImplGLES2_CreateFontsTexture();
+IMGUI_IMPL_API void     ImGui_ImplGLES2_DestroyFontsTexture();
+IMGUI_IMPL_API bool     ImGui_ImplGLES2_CreateDeviceObjects();
+IMGUI_IMPL_API void     ImGui_ImplGLES2_DestroyDeviceObjects();
+
+// Size of the font texture in GPU memory, in bytes. 0 until it's created.
+IMGUI_IMPL_API size_t   ImGui_ImplGLES2_GetFontTextureSize();
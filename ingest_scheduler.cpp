@@ -0,0 +1,80 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#include "ingest_scheduler.hpp"
+
+#include <algorithm>
+
+
+namespace
+{
+
+// Script output always gets at least this much time per frame
+constexpr auto minIngestTime = std::chrono::milliseconds{1};
+
+// Reserved on top of the estimated time for everything else, to cover
+// variations between frames and rendering work done by the GPU
+constexpr auto headroom = std::chrono::milliseconds{2};
+
+}
+
+
+IngestScheduler::IngestScheduler(const int framesPerSecond)
+  : mFramePeriod(
+      std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / std::max(framesPerSecond, 1))))
+  , mOtherWorkEstimate(Clock::duration::zero())
+{
+}
+
+
+IngestScheduler::Clock::duration IngestScheduler::beginFrame(
+  const bool handlingInput)
+{
+  mFrameStart = Clock::now();
+
+  if (handlingInput)
+  {
+    return minIngestTime;
+  }
+
+  return std::max<Clock::duration>(
+    mFramePeriod - mOtherWorkEstimate - headroom,
+    minIngestTime);
+}
+
+
+void IngestScheduler::endFrame(const Clock::duration ingestTime)
+{
+  const auto otherWork = Clock::now() - mFrameStart - ingestTime;
+
+  // Follow increases right away, so that a slow frame (e.g. lots of text
+  // to lay out after scrolling) doesn't get followed by another one. Only
+  // decrease gradually, since the work per frame varies quite a bit.
+  if (otherWork > mOtherWorkEstimate)
+  {
+    mOtherWorkEstimate = otherWork;
+  }
+  else
+  {
+    mOtherWorkEstimate -= (mOtherWorkEstimate - otherWork) / 8;
+  }
+}
@@ -0,0 +1,58 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#pragma once
+
+#include <chrono>
+
+
+// Splits the time of each frame between taking in script output and
+// everything else, i.e. handling input, building the UI and rendering.
+//
+// Taking in output happens on the UI thread, since the text is needed for
+// layout and rendering right away. A script writing as fast as it can
+// would keep it busy indefinitely, so it only gets a budget per frame.
+// Everything else gets a guaranteed share of the frame first: the time it
+// took in recent frames, plus some headroom. Whatever remains of the frame
+// period goes to the script output, but never less than a minimum, so
+// that the output keeps moving even if rendering alone takes too long.
+// Frames handling input only give the minimum to the script output, so
+// that the reaction to the input (e.g. closing the viewer) isn't delayed.
+class IngestScheduler {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit IngestScheduler(int framesPerSecond);
+
+  // To be called when starting a frame. Returns how much time can be spent
+  // on taking in script output during the frame.
+  Clock::duration beginFrame(bool handlingInput);
+
+  // To be called once everything for the frame has been submitted, but
+  // before waiting for vsync, with the time actually spent on script
+  // output
+  void endFrame(Clock::duration ingestTime);
+
+private:
+  Clock::duration mFramePeriod;
+  Clock::duration mOtherWorkEstimate;
+  Clock::time_point mFrameStart;
+};
@@ -0,0 +1,137 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#include "input_script.hpp"
+
+#include <sstream>
+#include <stdexcept>
+
+
+namespace
+{
+
+SDL_Scancode parseKey(const std::string& name)
+{
+  if (name == "up") return SDL_SCANCODE_UP;
+  if (name == "down") return SDL_SCANCODE_DOWN;
+  if (name == "left") return SDL_SCANCODE_LEFT;
+  if (name == "right") return SDL_SCANCODE_RIGHT;
+  if (name == "pageup") return SDL_SCANCODE_PAGEUP;
+  if (name == "pagedown") return SDL_SCANCODE_PAGEDOWN;
+  if (name == "home") return SDL_SCANCODE_HOME;
+  if (name == "end") return SDL_SCANCODE_END;
+  if (name == "wait") return SDL_SCANCODE_UNKNOWN;
+
+  throw std::invalid_argument("Unknown key '" + name + "' in input script");
+}
+
+
+void pushKeyEvent(const SDL_Scancode scancode, const bool pressed)
+{
+  SDL_Event event{};
+  event.type = pressed ? SDL_KEYDOWN : SDL_KEYUP;
+  event.key.state = pressed ? SDL_PRESSED : SDL_RELEASED;
+  event.key.keysym.scancode = scancode;
+  event.key.keysym.sym = SDL_GetKeyFromScancode(scancode);
+  SDL_PushEvent(&event);
+}
+
+}
+
+
+InputScript::InputScript(const std::string& script)
+  : mTotalFrames(0)
+{
+  std::istringstream stream(script);
+  std::string step;
+  while (std::getline(stream, step, ','))
+  {
+    const auto separatorPos = step.find(':');
+    const auto key = step.substr(0, separatorPos);
+
+    auto frameCount = std::uint64_t{1};
+    if (separatorPos != std::string::npos)
+    {
+      try
+      {
+        frameCount = std::stoull(step.substr(separatorPos + 1));
+      }
+      catch (const std::exception&)
+      {
+        throw std::invalid_argument("Invalid frame count in input script step '" + step + "'");
+      }
+    }
+
+    if (frameCount == 0)
+    {
+      continue;
+    }
+
+    mSteps.push_back({parseKey(key), frameCount});
+    mTotalFrames += frameCount;
+  }
+
+  if (mSteps.empty())
+  {
+    throw std::invalid_argument("Input script is empty");
+  }
+}
+
+
+void InputScript::pushEvents(const std::uint64_t frame) const
+{
+  // Keys are pressed on the first frame of a step, and released on the
+  // first frame of the next one. Releasing them during the step's last
+  // frame already would make Dear ImGui miss presses lasting one frame.
+  const auto current = stepIndexAt(frame);
+  const auto previous = frame > 0 ? stepIndexAt(frame - 1) : current;
+  if (frame > 0 && current == previous)
+  {
+    return;
+  }
+
+  if (frame > 0 && mSteps[previous].scancode != SDL_SCANCODE_UNKNOWN)
+  {
+    pushKeyEvent(mSteps[previous].scancode, false);
+  }
+
+  if (mSteps[current].scancode != SDL_SCANCODE_UNKNOWN)
+  {
+    pushKeyEvent(mSteps[current].scancode, true);
+  }
+}
+
+
+std::size_t InputScript::stepIndexAt(const std::uint64_t frame) const
+{
+  auto frameInStep = frame % mTotalFrames;
+  for (auto i = std::size_t{0}; i < mSteps.size(); ++i)
+  {
+    if (frameInStep < mSteps[i].frameCount)
+    {
+      return i;
+    }
+
+    frameInStep -= mSteps[i].frameCount;
+  }
+
+  return mSteps.size() - 1;
+}
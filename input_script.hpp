@@ -0,0 +1,62 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#pragma once
+
+#include <SDL.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Simulated keyboard input for running without a user, e.g. when
+// benchmarking in headless mode.
+//
+// A script is a comma separated list of steps in the form key:frames,
+// where key is one of up, down, left, right, pageup, pagedown, home, end
+// or wait, and frames is the number of frames to hold the key down for
+// (1 if omitted). "wait" doesn't press anything. For example,
+// "down:120,wait:30,pageup:10" scrolls down for 120 frames, waits for 30
+// frames, then pages up for 10 frames. The script starts over once it
+// reaches the end.
+class InputScript {
+public:
+  // Throws std::invalid_argument if the script can't be parsed
+  explicit InputScript(const std::string& script);
+
+  // Pushes the SDL events for the given frame (counting from 0) into
+  // SDL's event queue
+  void pushEvents(std::uint64_t frame) const;
+
+private:
+  struct Step
+  {
+    SDL_Scancode scancode;
+    std::uint64_t frameCount;
+  };
+
+  std::size_t stepIndexAt(std::uint64_t frame) const;
+
+  std::vector<Step> mSteps;
+  std::uint64_t mTotalFrames;
+};
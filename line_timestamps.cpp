@@ -0,0 +1,92 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#include "line_timestamps.hpp"
+
+#include <algorithm>
+
+
+void LineTimestamps::append(std::uint64_t time)
+{
+  time = std::max(time, mLastTime);
+
+  if (mEndLine % linesPerCheckpoint == 0)
+  {
+    mCheckpoints.push_back({time, mFirstOffset + mData.size()});
+  }
+  else
+  {
+    auto delta = time - mLastTime;
+    while (delta >= 0x80)
+    {
+      mData.push_back(std::uint8_t(delta | 0x80));
+      delta >>= 7;
+    }
+    mData.push_back(std::uint8_t(delta));
+  }
+
+  mLastTime = time;
+  ++mEndLine;
+}
+
+
+void LineTimestamps::dropBefore(const std::size_t line)
+{
+  // The last group is still being added to, so it's always kept
+  while (
+    mCheckpoints.size() > 1 &&
+    (mFirstCheckpoint + 1) * linesPerCheckpoint <= line)
+  {
+    const auto nextOffset = mCheckpoints[1].offset;
+    mData.erase(mData.begin(), mData.begin() + (nextOffset - mFirstOffset));
+    mFirstOffset = nextOffset;
+
+    mCheckpoints.pop_front();
+    ++mFirstCheckpoint;
+  }
+}
+
+
+std::uint64_t LineTimestamps::get(const std::size_t line) const
+{
+  const auto& checkpoint =
+    mCheckpoints[line / linesPerCheckpoint - mFirstCheckpoint];
+
+  auto time = checkpoint.time;
+  auto iData = mData.begin() + (checkpoint.offset - mFirstOffset);
+  for (auto i = line % linesPerCheckpoint; i > 0; --i)
+  {
+    auto delta = std::uint64_t{0};
+    auto shift = 0;
+    std::uint8_t byte;
+    do
+    {
+      byte = *iData++;
+      delta |= std::uint64_t(byte & 0x7F) << shift;
+      shift += 7;
+    }
+    while (byte & 0x80);
+
+    time += delta;
+  }
+
+  return time;
+}
@@ -0,0 +1,91 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+
+// Remembers when each line of a script's output arrived, e.g. as
+// microseconds since the script was started.
+//
+// This is kept for a lot of lines, so it needs to be compact. Each time is
+// stored as the difference to the previous line's, encoded as a varint
+// (7 bits per byte, the top bit marks that more bytes follow). Lines
+// arriving together take up a single byte, and the gaps between the lines
+// of a slow script two or three. To look up a line without decoding all
+// the ones before it, the absolute time and position in the encoded data
+// is stored for every 64th line.
+//
+// Like in TextBuffer, lines are addressed by index, and the oldest ones
+// can be dropped.
+class LineTimestamps {
+public:
+  // Adds the next line. Times must not decrease, a smaller time is
+  // replaced by the previous line's.
+  void append(std::uint64_t time);
+
+  // Drops lines before the given one. This happens in groups, so some
+  // earlier lines might remain.
+  void dropBefore(std::size_t line);
+
+  std::size_t firstLine() const
+  {
+    return mFirstCheckpoint * linesPerCheckpoint;
+  }
+
+  std::size_t endLine() const { return mEndLine; }
+
+  bool contains(const std::size_t line) const
+  {
+    return line >= firstLine() && line < mEndLine;
+  }
+
+  // The line needs to be contained
+  std::uint64_t get(std::size_t line) const;
+
+  // Time of the last line, or 0 if there are none
+  std::uint64_t lastTime() const { return mLastTime; }
+
+private:
+  static constexpr auto linesPerCheckpoint = std::size_t{64};
+
+  struct Checkpoint
+  {
+    std::uint64_t time;
+
+    // Position of the following line's data, counting from the first
+    // byte ever added
+    std::uint64_t offset;
+  };
+
+  // Differences for all lines which don't have a checkpoint
+  std::deque<std::uint8_t> mData;
+  std::uint64_t mFirstOffset = 0;
+
+  std::deque<Checkpoint> mCheckpoints;
+  std::size_t mFirstCheckpoint = 0;
+
+  std::size_t mEndLine = 0;
+  std::uint64_t mLastTime = 0;
+};
@@ -0,0 +1,171 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#include "log_index.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+
+
+namespace
+{
+
+constexpr auto checkpointInterval = std::size_t{4096};
+
+constexpr auto readSize = std::size_t{64 * 1024};
+
+}
+
+
+LogIndex::LogIndex(const std::string& logFile)
+  : mFd(open(logFile.c_str(), O_RDONLY | O_CLOEXEC))
+{
+  if (mFd == -1)
+  {
+    throw std::runtime_error("Failed to open log file " + logFile);
+  }
+}
+
+
+LogIndex::~LogIndex()
+{
+  close(mFd);
+}
+
+
+void LogIndex::addOutput(
+  const std::string_view output,
+  const bool fromStderr,
+  const TextBuffer& text,
+  const AnsiParser& outputParser,
+  const AnsiParser& errorParser)
+{
+  const auto partial = !text.lastLineComplete();
+  const auto line = partial ? text.endLine() - 1 : text.endLine();
+  if (mCheckpoints.empty() || line >= mCheckpoints.back().line + checkpointInterval)
+  {
+    mCheckpoints.push_back({mLogSize, line, partial, outputParser, errorParser});
+  }
+
+  if (fromStderr)
+  {
+    if (!mStderrRanges.empty() && mStderrRanges.back().end == mLogSize)
+    {
+      mStderrRanges.back().end += output.size();
+    }
+    else
+    {
+      mStderrRanges.push_back({mLogSize, mLogSize + output.size()});
+    }
+  }
+
+  mLogSize += output.size();
+}
+
+
+std::size_t LogIndex::restoreLines(TextBuffer& text, const std::size_t maxCount) const
+{
+  const auto end = text.firstLine();
+  const auto first = end - std::min(end, maxCount);
+  if (first == end)
+  {
+    return 0;
+  }
+
+  // Find the last checkpoint before the first line we need. The line at
+  // the checkpoint itself is only usable if it starts there.
+  const auto iNext = std::partition_point(
+    mCheckpoints.begin(),
+    mCheckpoints.end(),
+    [&](const Checkpoint& checkpoint)
+    {
+      return checkpoint.line + (checkpoint.partial ? 1 : 0) <= first;
+    });
+  if (iNext == mCheckpoints.begin())
+  {
+    return 0;
+  }
+
+  const auto& checkpoint = *std::prev(iNext);
+
+  // Line i of the log ends up as line i - checkpoint.line in here
+  auto lines = TextBuffer{};
+  auto outputParser = AnsiParser{lines, checkpoint.outputParser};
+  auto errorParser = AnsiParser{lines, checkpoint.errorParser};
+
+  auto iStderrRange = std::partition_point(
+    mStderrRanges.begin(),
+    mStderrRanges.end(),
+    [&](const Range& range) { return range.end <= checkpoint.offset; });
+
+  // We need to get to the start of the line after the last one we want,
+  // to be sure that it's complete
+  auto buffer = std::vector<char>(readSize);
+  auto offset = checkpoint.offset;
+  while (checkpoint.line + lines.endLine() <= end && offset < mLogSize)
+  {
+    const auto size =
+      std::size_t(std::min<std::uint64_t>(readSize, mLogSize - offset));
+    const auto bytesRead = pread(mFd, buffer.data(), size, off_t(offset));
+    if (bytesRead <= 0)
+    {
+      if (bytesRead == -1 && errno == EINTR)
+      {
+        continue;
+      }
+
+      return 0;
+    }
+
+    auto data = std::string_view{buffer.data(), std::size_t(bytesRead)};
+    while (!data.empty())
+    {
+      while (iStderrRange != mStderrRanges.end() && iStderrRange->end <= offset)
+      {
+        ++iStderrRange;
+      }
+
+      const auto inStderrRange =
+        iStderrRange != mStderrRanges.end() && iStderrRange->begin <= offset;
+      const auto rangeEnd = iStderrRange == mStderrRanges.end()
+        ? mLogSize
+        : inStderrRange ? iStderrRange->end : iStderrRange->begin;
+      const auto part = data.substr(
+        0, std::size_t(std::min<std::uint64_t>(data.size(), rangeEnd - offset)));
+
+      (inStderrRange ? errorParser : outputParser).parse(part);
+      data.remove_prefix(part.size());
+      offset += part.size();
+    }
+  }
+
+  if (checkpoint.line + lines.endLine() <= end)
+  {
+    return 0;
+  }
+
+  text.prepend(lines, first - checkpoint.line, end - checkpoint.line);
+  return end - first;
+}
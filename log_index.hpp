@@ -0,0 +1,89 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#pragma once
+
+#include "ansi_parser.hpp"
+#include "text_buffer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// Keeps track of where each line of a script's output is in the log file
+// written by ScriptReader, so that lines which were dropped from the text
+// buffer due to its limits can be loaded from there again.
+//
+// Parsing the whole log each time would take too long, so every few
+// thousand lines, we remember the position in the log together with the
+// state of the parsers. Lines are loaded by parsing the log from the
+// closest such checkpoint. The log doesn't say which output came from
+// stderr, so we also remember where that is.
+class LogIndex {
+public:
+  explicit LogIndex(const std::string& logFile);
+  ~LogIndex();
+
+  LogIndex(const LogIndex&) = delete;
+  LogIndex& operator=(const LogIndex&) = delete;
+
+  // To be called with each piece of output before it's parsed, in the same
+  // order as it was written to the log
+  void addOutput(
+    std::string_view output,
+    bool fromStderr,
+    const TextBuffer& text,
+    const AnsiParser& outputParser,
+    const AnsiParser& errorParser);
+
+  // Loads up to maxCount of the lines right before the first one in text
+  // from the log, and puts them back into text. Returns the number of
+  // lines restored.
+  std::size_t restoreLines(TextBuffer& text, std::size_t maxCount) const;
+
+private:
+  struct Checkpoint
+  {
+    std::uint64_t offset;
+
+    // The line which the output at offset goes into, and whether part of
+    // it came before offset
+    std::size_t line;
+    bool partial;
+
+    AnsiParser outputParser;
+    AnsiParser errorParser;
+  };
+
+  struct Range
+  {
+    std::uint64_t begin;
+    std::uint64_t end;
+  };
+
+  int mFd;
+  std::uint64_t mLogSize = 0;
+  std::vector<Checkpoint> mCheckpoints;
+  std::vector<Range> mStderrRanges;
+};
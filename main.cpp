@@ -19,17 +19,30 @@
   * SOFTWARE.
   */
 
+#include "font_cache.hpp"
+#include "glyph_cache.hpp"
+#include "frame_pacer.hpp"
+#include "hash.hpp"
+#include "ingest_scheduler.hpp"
+#include "input_script.hpp"
+#include "scaled_framebuffer.hpp"
+#include "stats.hpp"
+#include "text_renderer.hpp"
 #include "view.hpp"
 
 #include "imgui.h"
 #include "imgui_internal.h"
 #include "imgui_impl_sdl.h"
-#include "imgui_impl_opengl3.h"
+#include "imgui_impl_gles2.h"
 
 #include <cxxopts.hpp>
 #include <GLES2/gl2.h>
 #include <SDL.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
@@ -39,6 +52,33 @@
 namespace
 {
 
+// Number of frames we keep rendering after something happened (input,
+// script output etc.) before going idle. Dear ImGui sometimes needs a
+// couple of frames to settle, e.g. scroll requests are applied on the
+// frame after they were made.
+constexpr auto settleFrameCount = 3;
+
+// How long to sleep at most while idle. Nothing is rendered when this
+// expires, it's only a safety net in case a wakeup gets lost somehow.
+constexpr auto idleTimeoutMs = 500;
+
+// Upper bound for the time step passed to Dear ImGui. After idling, the
+// time since the last frame can be arbitrarily long, which would make
+// time-based things like gamepad scrolling jump on the first new frame.
+constexpr auto maxDeltaTime = 1.0f / 30.0f;
+
+// Analog stick values below this are treated as noise, same as in
+// imgui_impl_sdl.cpp.
+constexpr auto thumbDeadZone = 8000;
+
+// Size of Dear ImGui's built-in font
+constexpr auto defaultFontSize = 13.0f;
+
+// There is no display to take the size from in headless mode
+constexpr auto headlessWindowWidth = 1280;
+constexpr auto headlessWindowHeight = 720;
+
+
 // Parses command line options and returns a ParseResult if successful.
 // Returns an empty optional otherwise.
 // This function defines all available command line arguments.
@@ -54,13 +94,30 @@ std::optional<cxxopts::ParseResult> parseArgs(int argc, char** argv)
       .show_positional_help()
       .add_options()
         ("input_file", "text file to view", cxxopts::value<std::string>())
-        ("s,script_file", "script outpout to view", cxxopts::value<std::string>())
+        ("s,script_file", "script outpout to view; started directly, or via /bin/sh if it has no #! line", cxxopts::value<std::string>())
+        ("script_shell", "run the script file as a shell command line, e.g. to pass arguments (starts slower than running it directly)")
+        ("script_pty", "run the script in a pseudoterminal, so that programs flush their output after each line instead of in large blocks")
+        ("max_lines", "keep at most this many lines, dropping the oldest ones (0 means no limit)", cxxopts::value<std::size_t>()->default_value("0"))
+        ("max_bytes", "keep at most this much text in bytes, dropping the oldest lines (0 means no limit)", cxxopts::value<std::size_t>()->default_value("0"))
+        ("timestamps", "show when each line of the script's output arrived, in seconds since the script was started")
+        ("tee", "also write the script's output to this file; with max_lines/max_bytes, dropped lines are loaded back from it when scrolling up", cxxopts::value<std::string>())
+        ("interval", "run the script again this many seconds after it finished, updating the text in place and highlighting changed lines (like watch)", cxxopts::value<double>())
         ("m,message", "text to show instead of viewing a file", cxxopts::value<std::string>())
         ("f,font_size", "font size in pixels", cxxopts::value<int>())
+        ("glyph_font", "font file to take characters missing from the built-in font from (e.g. CJK), rasterized on demand", cxxopts::value<std::string>())
         ("t,title", "window title (filename by default)", cxxopts::value<std::string>())
         ("y,yes_button", "shows a yes button with different exit code")
         ("e,error_display", "format as error, background will be red")
         ("w,wrap_lines", "wrap long lines of text. WARNING: could be slow for large files!")
+        ("p,print_stats", "print rendering statistics on exit")
+        ("max_fps", "limit the frame rate (0 means no limit)", cxxopts::value<int>()->default_value("0"))
+        ("vsync", "vertical sync mode: adaptive, on or off", cxxopts::value<std::string>()->default_value("adaptive"))
+        ("tile_cache_mb", "render the text into cached textures using up to this much GPU memory, for GPUs which struggle with many glyphs (0 disables)", cxxopts::value<int>()->default_value("0"))
+        ("render_scale", "render the UI at this fraction of the display resolution (0 to 1) and scale it up, for GPUs which can't fill the whole display fast enough", cxxopts::value<float>()->default_value("1"))
+        ("blended_background", "draw the window background with blending like Dear ImGui normally does, instead of clearing to its color (for comparison)")
+        ("rgba_atlas", "upload the font atlas as RGBA instead of alpha only (for comparison)")
+        ("headless", "render the given number of frames without a display, using SDL's offscreen video driver, then print statistics (for benchmarking)", cxxopts::value<int>())
+        ("input_script", "simulated key presses in headless mode, as comma separated key:frames steps (keys: up, down, left, right, pageup, pagedown, home, end, wait)", cxxopts::value<std::string>()->default_value("down:300,pagedown:60,up:300,pageup:60"))
         ("h,help", "show help")
       ;
 
@@ -96,6 +153,92 @@ std::optional<cxxopts::ParseResult> parseArgs(int argc, char** argv)
         return {};
       }
 
+      if (result.count("tee") && !result.count("script_file"))
+      {
+        std::cerr << "Error: tee can only be used together with script_file\n\n";
+        std::cerr << options.help({""}) << '\n';
+        return {};
+      }
+
+      if (result.count("interval"))
+      {
+        if (!result.count("script_file"))
+        {
+          std::cerr << "Error: interval can only be used together with script_file\n\n";
+          std::cerr << options.help({""}) << '\n';
+          return {};
+        }
+
+        if (result.count("tee"))
+        {
+          std::cerr << "Error: Cannot use interval and tee at the same time\n\n";
+          std::cerr << options.help({""}) << '\n';
+          return {};
+        }
+
+        if (!(result["interval"].as<double>() > 0.0))
+        {
+          std::cerr << "Error: interval must be greater than 0\n\n";
+          std::cerr << options.help({""}) << '\n';
+          return {};
+        }
+      }
+
+      if (result.count("timestamps") && !result.count("script_file"))
+      {
+        std::cerr << "Error: timestamps can only be used together with script_file\n\n";
+        std::cerr << options.help({""}) << '\n';
+        return {};
+      }
+
+      if (result["max_fps"].as<int>() < 0)
+      {
+        std::cerr << "Error: max_fps cannot be negative\n\n";
+        std::cerr << options.help({""}) << '\n';
+        return {};
+      }
+
+      if (result["tile_cache_mb"].as<int>() < 0)
+      {
+        std::cerr << "Error: tile_cache_mb cannot be negative\n\n";
+        std::cerr << options.help({""}) << '\n';
+        return {};
+      }
+
+      const auto renderScale = result["render_scale"].as<float>();
+      if (!(renderScale > 0.0f && renderScale <= 1.0f))
+      {
+        std::cerr << "Error: render_scale must be greater than 0 and at most 1\n\n";
+        std::cerr << options.help({""}) << '\n';
+        return {};
+      }
+
+      if (result.count("headless") && result["headless"].as<int>() <= 0)
+      {
+        std::cerr << "Error: headless needs a frame count greater than 0\n\n";
+        std::cerr << options.help({""}) << '\n';
+        return {};
+      }
+
+      try
+      {
+        InputScript{result["input_script"].as<std::string>()};
+      }
+      catch (const std::invalid_argument& error)
+      {
+        std::cerr << "Error: " << error.what() << "\n\n";
+        std::cerr << options.help({""}) << '\n';
+        return {};
+      }
+
+      const auto& vsyncMode = result["vsync"].as<std::string>();
+      if (vsyncMode != "adaptive" && vsyncMode != "on" && vsyncMode != "off")
+      {
+        std::cerr << "Error: Invalid vsync mode '" << vsyncMode << "'\n\n";
+        std::cerr << options.help({""}) << '\n';
+        return {};
+      }
+
       // All verification steps passed, we can return the parsed options
       return result;
 
@@ -204,8 +347,130 @@ std::string determineTitle(const cxxopts::ParseResult& args)
 }
 
 
-// This function implements the main loop
-int run(SDL_Window* pWindow, const cxxopts::ParseResult& args)
+// Returns true if Dear ImGui needs further frames even when no new
+// events arrive. This is the case while a key, gamepad button or stick
+// is held down (which scrolls continuously and triggers key repeat),
+// or while a widget is being interacted with.
+bool imGuiNeedsMoreFrames()
+{
+  const auto& context = *ImGui::GetCurrentContext();
+  if (
+    context.ActiveId != 0 ||
+    context.NavWindowingTarget ||
+    ImGui::IsAnyMouseDown())
+  {
+    return true;
+  }
+
+  for (auto key = int(ImGuiKey_NamedKey_BEGIN); key < ImGuiKey_NamedKey_END; ++key)
+  {
+    if (ImGui::IsKeyDown(ImGuiKey(key)))
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+// Returns true for events which don't require rendering a new frame.
+// Analog sticks report tiny movements around their rest position all
+// the time, we don't want those to keep us from going idle.
+bool isIdleNoise(const SDL_Event& event)
+{
+  if (event.type == SDL_CONTROLLERAXISMOTION)
+  {
+    return std::abs(event.caxis.value) < thumbDeadZone;
+  }
+
+  return event.type == SDL_JOYAXISMOTION;
+}
+
+
+// Refresh rate of the display showing the given window, or a typical
+// value if it can't be determined
+int displayRefreshRate(SDL_Window* pWindow)
+{
+  SDL_DisplayMode mode;
+  const auto displayIndex = SDL_GetWindowDisplayIndex(pWindow);
+  if (
+    displayIndex >= 0 &&
+    SDL_GetCurrentDisplayMode(displayIndex, &mode) == 0 &&
+    mode.refresh_rate > 0)
+  {
+    return mode.refresh_rate;
+  }
+
+  return 60;
+}
+
+
+// Computes a hash over everything that determines how the given draw data
+// looks on screen. If two frames have the same hash, the second one
+// doesn't need to be presented.
+std::uint64_t hashDrawData(const ImDrawData& drawData)
+{
+  auto hash = std::uint64_t{0};
+  hash = hashBytes(&drawData.DisplayPos, sizeof(ImVec2), hash);
+  hash = hashBytes(&drawData.DisplaySize, sizeof(ImVec2), hash);
+  hash = hashBytes(&drawData.FramebufferScale, sizeof(ImVec2), hash);
+
+  for (auto i = 0; i < drawData.CmdListsCount; ++i)
+  {
+    const auto& drawList = *drawData.CmdLists[i];
+
+    // ImDrawCmd zeroes its padding on construction, so hashing the raw
+    // bytes is fine.
+    hash = hashBytes(
+      drawList.CmdBuffer.Data, drawList.CmdBuffer.size_in_bytes(), hash);
+    hash = hashBytes(
+      drawList.IdxBuffer.Data, drawList.IdxBuffer.size_in_bytes(), hash);
+    hash = hashBytes(
+      drawList.VtxBuffer.Data, drawList.VtxBuffer.size_in_bytes(), hash);
+  }
+
+  return hash;
+}
+
+
+// Dear ImGui's window background is slightly transparent, and gets
+// blended over whatever is behind the window. Our window covers the
+// whole screen though, so the only thing behind it is the color the
+// screen is cleared to. Clearing to the blended result right away, and
+// not drawing the background at all, looks the same but saves blending
+// every pixel of the screen once more.
+//
+// Makes the window background transparent in the given style, which
+// makes Dear ImGui skip drawing it, and returns the color to clear the
+// screen to.
+ImVec4 takeOverWindowBackground(ImGuiStyle& style)
+{
+  auto& background = style.Colors[ImGuiCol_WindowBg];
+  const auto clearColor = ImVec4{
+    background.x * background.w,
+    background.y * background.w,
+    background.z * background.w,
+    1.0f};
+
+  background.w = 0.0f;
+  return clearColor;
+}
+
+
+// This function implements the main loop.
+//
+// Instead of rendering continuously, we only render when something
+// happened: Input events, output from a running script, or Dear ImGui
+// itself requesting further frames (see imGuiNeedsMoreFrames). The rest
+// of the time, we sleep in SDL_WaitEventTimeout(), to save battery.
+// Frames which turn out identical to the previous one aren't presented.
+// While rendering, the frame rate is limited according to --max_fps.
+int run(
+  SDL_Window* pWindow,
+  GlyphCache* pGlyphCache,
+  const ImVec4& clearColor,
+  const cxxopts::ParseResult& args)
 {
   // Data structures and helper functions for dealing with controllers
   
@@ -238,70 +503,299 @@ int run(SDL_Window* pWindow, const cxxopts::ParseResult& args)
   };
 
 
+  // Output from a running script is read on a background thread, which
+  // pushes an event of this type to wake us up from SDL_WaitEventTimeout()
+  // when there is new output.
+  const auto scriptOutputEventType = SDL_RegisterEvents(1);
+
   // Create the view object. This is where all the core logic
   // is implemented. See view.hpp/view.cpp.
   // Ideally, all command line options should be converted to plain
   // C++ types before handing them over to the View, to
   // avoid making the View dependent on cxxopts.
+  TextRenderer textRenderer{
+    pGlyphCache,
+    std::size_t(args["tile_cache_mb"].as<int>()) * 1024 * 1024};
   auto view = View{
+    textRenderer,
+    pGlyphCache,
     determineTitle(args),
     readInputOrScriptName(args),
     args.count("yes_button") > 0,
     args.count("wrap_lines") > 0,
-    args.count("script_file") > 0};
+    args.count("script_file") > 0,
+    args.count("script_shell") > 0,
+    args.count("script_pty") > 0,
+    args.count("tee") ? args["tee"].as<std::string>() : std::string{},
+    args.count("timestamps") > 0,
+    args.count("interval")
+      ? std::chrono::duration_cast<View::Clock::duration>(
+          std::chrono::duration<double>(args["interval"].as<double>()))
+      : View::Clock::duration::zero(),
+    scriptOutputEventType,
+    args["max_lines"].as<std::size_t>(),
+    args["max_bytes"].as<std::size_t>()};
+
+  auto& io = ImGui::GetIO();
+
+  // Handles a single event. Returns true if we need to quit.
+  auto pendingFrames = settleFrameCount;
+  std::optional<Uint32> inputTimestamp;
+  auto forcePresent = true;
+  auto lastPresentedHash = std::uint64_t{0};
+  auto handleEvent = [&](const SDL_Event& event)
+  {
+    // Forward events to Dear ImGui
+    ImGui_ImplSDL2_ProcessEvent(&event);
+
+    // Check if we need to quit, this directly handles some controller events.
+    // Most controller events are handled by ImGui instead.
+    if (
+      event.type == SDL_QUIT ||
+      (event.type == SDL_CONTROLLERBUTTONDOWN &&
+       (event.cbutton.button == SDL_CONTROLLER_BUTTON_GUIDE || event.cbutton.button == SDL_CONTROLLER_BUTTON_BACK)) ||
+      (event.type == SDL_WINDOWEVENT &&
+       event.window.event == SDL_WINDOWEVENT_CLOSE &&
+       event.window.windowID == SDL_GetWindowID(pWindow))
+    ) {
+      return true;
+    }
+
+    // Handle controller hot-plugging
+    if (
+      event.type == SDL_CONTROLLERDEVICEADDED ||
+      event.type == SDL_CONTROLLERDEVICEREMOVED)
+    {
+      enumerateGameControllers();
+    }
+
+    // The window contents might have been lost (exposed, resized etc.),
+    // so we need to present the next frame even if it's unchanged.
+    if (event.type == SDL_WINDOWEVENT)
+    {
+      forcePresent = true;
+    }
+
+    if (!isIdleNoise(event))
+    {
+      pendingFrames = settleFrameCount;
+
+      // Remember when the oldest input not reacted to yet happened
+      if (event.type != scriptOutputEventType && !inputTimestamp)
+      {
+        inputTimestamp = event.common.timestamp;
+      }
+    }
+
+    return false;
+  };
 
-  const auto& io = ImGui::GetIO();
+  // With --render_scale, the UI is rendered into an offscreen framebuffer
+  // at reduced resolution, and then scaled up to the window size
+  const auto renderScale = args["render_scale"].as<float>();
+  std::optional<ScaledFramebuffer> scaledFramebuffer;
+  if (renderScale != 1.0f)
+  {
+    scaledFramebuffer.emplace();
+  }
+
+  // In headless mode, a fixed number of frames is rendered back to back,
+  // driven by simulated input instead of waiting for events
+  const auto headlessFrameCount =
+    args.count("headless") ? std::uint64_t(args["headless"].as<int>()) : 0;
+  std::optional<InputScript> inputScript;
+  if (headlessFrameCount > 0)
+  {
+    inputScript.emplace(args["input_script"].as<std::string>());
+  }
+
+  auto pacer = FramePacer{args["max_fps"].as<int>()};
+
+  // Without vsync, nothing limits how often frames are built while there
+  // is no input. A script producing output continuously would then cause
+  // a frame, with its layout update and scrolling, for every little bit
+  // of it. Such frames are limited to the display's refresh rate, which
+  // is as often as the result can be seen anyway. Input is still handled
+  // right away.
+  const auto vsyncOff = args["vsync"].as<std::string>() == "off";
+  const auto refreshRate = displayRefreshRate(pWindow);
+  auto refreshPacer =
+    FramePacer{vsyncOff && headlessFrameCount == 0 ? refreshRate : 0};
+
+  // Script output is taken in with whatever time is left in each frame,
+  // see IngestScheduler. Frames come at the display's refresh rate, unless
+  // limited further by --max_fps, or not limited by vsync at all.
+  const auto maxFps = args["max_fps"].as<int>();
+  auto ingestScheduler = IngestScheduler{
+    maxFps > 0 && (maxFps < refreshRate || vsyncOff) ? maxFps : refreshRate};
+  const auto performanceFrequency = double(SDL_GetPerformanceFrequency());
+  // Start of the previous frame, or 0 if we were idle in between
+  Uint64 lastFrameStart = 0;
 
   // Keep running until an exit code is set
   std::optional<int> exitCode;
   while (!exitCode)
   {
-    // Process pending events
     SDL_Event event;
-    while (SDL_PollEvent(&event))
+
+    if (inputScript)
     {
-      // Forward events to Dear ImGui
-      ImGui_ImplSDL2_ProcessEvent(&event);
-
-      // Check if we need to quit, this directly handles some controller events.
-      // Most controller events are handled by ImGui instead.
-      if (
-        event.type == SDL_QUIT ||
-        (event.type == SDL_CONTROLLERBUTTONDOWN &&
-         (event.cbutton.button == SDL_CONTROLLER_BUTTON_GUIDE || event.cbutton.button == SDL_CONTROLLER_BUTTON_BACK)) ||
-        (event.type == SDL_WINDOWEVENT &&
-         event.window.event == SDL_WINDOWEVENT_CLOSE &&
-         event.window.windowID == SDL_GetWindowID(pWindow))
-      ) {
+      if (stats().builtFrames >= headlessFrameCount)
+      {
         return 0;
       }
 
-      // Handle controller hot-plugging
-      if (
-        event.type == SDL_CONTROLLERDEVICEADDED ||
-        event.type == SDL_CONTROLLERDEVICEREMOVED)
+      inputScript->pushEvents(stats().builtFrames);
+      pendingFrames = settleFrameCount;
+    }
+
+    if (pendingFrames == 0)
+    {
+      // If there's nothing to render, sleep until the next event arrives
+      pacer.reset();
+      refreshPacer.reset();
+      lastFrameStart = 0;
+
+      if (SDL_WaitEventTimeout(&event, idleTimeoutMs) && handleEvent(event))
       {
-        enumerateGameControllers();
+        return 0;
       }
     }
+    else
+    {
+      pacer.waitForNextFrame();
+    }
+
+    // Process pending events
+    while (SDL_PollEvent(&event))
+    {
+      if (handleEvent(event))
+      {
+        return 0;
+      }
+    }
+
+    if (pendingFrames == 0)
+    {
+      continue;
+    }
+
+    const auto handlingInput = inputTimestamp.has_value();
+    if (!handlingInput)
+    {
+      refreshPacer.waitForNextFrame();
+    }
+
+    const auto frameStart = SDL_GetPerformanceCounter();
+    if (lastFrameStart != 0)
+    {
+      stats().frameTimes.add(
+        (frameStart - lastFrameStart) * 1000.0 / performanceFrequency);
+    }
+    lastFrameStart = frameStart;
 
     // Start the Dear ImGui frame
-    ImGui_ImplOpenGL3_NewFrame();
+    ImGui_ImplGLES2_NewFrame();
     ImGui_ImplSDL2_NewFrame(pWindow, gameControllers);
+    io.DeltaTime = std::min(io.DeltaTime, maxDeltaTime);
+
+    // When rendering at reduced resolution, Dear ImGui works in the
+    // coordinates of the offscreen framebuffer. The mouse position is
+    // in window coordinates, so it needs to be scaled as well.
+    int drawableWidth = 0;
+    int drawableHeight = 0;
+    SDL_GL_GetDrawableSize(pWindow, &drawableWidth, &drawableHeight);
+
+    const auto renderScaled =
+      scaledFramebuffer && io.DisplaySize.x > 0.0f && io.DisplaySize.y > 0.0f;
+    if (renderScaled)
+    {
+      const auto windowSize = io.DisplaySize;
+      io.DisplaySize = {
+        std::max(std::floor(drawableWidth * renderScale), 1.0f),
+        std::max(std::floor(drawableHeight * renderScale), 1.0f)};
+      io.DisplayFramebufferScale = {1.0f, 1.0f};
+
+      if (ImGui::IsMousePosValid(&io.MousePos))
+      {
+        io.MousePos.x *= io.DisplaySize.x / windowSize.x;
+        io.MousePos.y *= io.DisplaySize.y / windowSize.y;
+      }
+    }
     ImGui::NewFrame();
 
     // Draw the UI, respond to user input etc.
-    exitCode = view.draw(io.DisplaySize);
+    exitCode = view.draw(
+      io.DisplaySize,
+      ingestScheduler.beginFrame(handlingInput));
 
-    // Render and swap buffers to present the new frame
     ImGui::Render();
+    ++stats().builtFrames;
+
+    // Many frames look exactly like the previous one, e.g. when holding
+    // a button while already scrolled to the end. Presenting those again
+    // would only waste power, so we skip them.
+    const auto textStateHash = textRenderer.drawStateHash();
+    const auto drawDataHash = hashBytes(
+      &textStateHash,
+      sizeof(textStateHash),
+      hashDrawData(*ImGui::GetDrawData()));
+    if (forcePresent || drawDataHash != lastPresentedHash)
+    {
+      // Render and swap buffers to present the new frame
+      if (renderScaled)
+      {
+        scaledFramebuffer->bind((int)io.DisplaySize.x, (int)io.DisplaySize.y);
+      }
 
-    glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-   
-    SDL_GL_SwapWindow(pWindow);
+      // The renderer leaves scissoring enabled, which would limit clearing
+      // to the last clip rectangle of the previous frame
+      glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
+      glDisable(GL_SCISSOR_TEST);
+      glClearColor(clearColor.x, clearColor.y, clearColor.z, clearColor.w);
+      glClear(GL_COLOR_BUFFER_BIT);
+      ImGui_ImplGLES2_RenderDrawData(ImGui::GetDrawData());
+
+      if (renderScaled)
+      {
+        scaledFramebuffer->present(drawableWidth, drawableHeight);
+      }
+
+      ingestScheduler.endFrame(view.scriptReadTime());
+      SDL_GL_SwapWindow(pWindow);
+
+      // Without a display, nothing waits for rendering to finish. Do
+      // that here, so that the frame times include the actual rendering.
+      if (inputScript)
+      {
+        glFinish();
+      }
+
+      lastPresentedHash = drawDataHash;
+      forcePresent = false;
+      ++stats().presentedFrames;
+    }
+    else
+    {
+      ingestScheduler.endFrame(view.scriptReadTime());
+      ++stats().skippedFrames;
+    }
+
+    if (inputTimestamp)
+    {
+      stats().inputLatency.add(double(SDL_GetTicks() - *inputTimestamp));
+      inputTimestamp.reset();
+    }
+
+    // Decide if we need to keep rendering, or can go idle soon
+    if (imGuiNeedsMoreFrames())
+    {
+      pendingFrames = settleFrameCount;
+    }
+    else
+    {
+      --pendingFrames;
+    }
   }
 
   return *exitCode;
@@ -341,6 +835,14 @@ int main(int argc, char** argv)
     }
   }
 
+  // Headless mode renders into offscreen buffers. With Mesa, this works
+  // without any GPU at all, using llvmpipe.
+  const auto headless = args.count("headless") > 0;
+  if (headless)
+  {
+    SDL_setenv("SDL_VIDEODRIVER", "offscreen", 1);
+  }
+
   // Setup SDL
   if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_GAMECONTROLLER) != 0)
   {
@@ -359,17 +861,59 @@ int main(int argc, char** argv)
   SDL_DisplayMode displayMode;
   SDL_GetDesktopDisplayMode(0, &displayMode);
 
-  auto pWindow = SDL_CreateWindow(
-    "Log Viewer",
-    SDL_WINDOWPOS_CENTERED,
-    SDL_WINDOWPOS_CENTERED,
-    displayMode.w,
-    displayMode.h,
-    SDL_WINDOW_OPENGL | SDL_WINDOW_FULLSCREEN | SDL_WINDOW_ALLOW_HIGHDPI);
+  auto pWindow = headless
+    ? SDL_CreateWindow(
+        "Log Viewer",
+        SDL_WINDOWPOS_UNDEFINED,
+        SDL_WINDOWPOS_UNDEFINED,
+        headlessWindowWidth,
+        headlessWindowHeight,
+        SDL_WINDOW_OPENGL)
+    : SDL_CreateWindow(
+        "Log Viewer",
+        SDL_WINDOWPOS_CENTERED,
+        SDL_WINDOWPOS_CENTERED,
+        displayMode.w,
+        displayMode.h,
+        SDL_WINDOW_OPENGL | SDL_WINDOW_FULLSCREEN | SDL_WINDOW_ALLOW_HIGHDPI);
+  if (!pWindow)
+  {
+    std::cerr << "Error: " << SDL_GetError() << '\n';
+    SDL_Quit();
+    return -1;
+  }
 
   auto pGlContext = SDL_GL_CreateContext(pWindow);
+  if (!pGlContext)
+  {
+    std::cerr << "Error: " << SDL_GetError() << '\n';
+    SDL_DestroyWindow(pWindow);
+    SDL_Quit();
+    return -1;
+  }
+
   SDL_GL_MakeCurrent(pWindow, pGlContext);
-  SDL_GL_SetSwapInterval(1); // Enable vsync
+
+  // Adaptive vsync doesn't wait for the next vblank if we missed the last
+  // one, avoiding stutter. Not all drivers support it, so fall back to
+  // regular vsync if needed.
+  // There's nothing to sync to in headless mode
+  const auto& vsyncMode = args["vsync"].as<std::string>();
+  if (headless)
+  {
+    SDL_GL_SetSwapInterval(0);
+  }
+  else if (vsyncMode == "adaptive")
+  {
+    if (SDL_GL_SetSwapInterval(-1) != 0)
+    {
+      SDL_GL_SetSwapInterval(1);
+    }
+  }
+  else
+  {
+    SDL_GL_SetSwapInterval(vsyncMode == "on" ? 1 : 0);
+  }
 
   // Setup Dear ImGui context
   IMGUI_CHECKVERSION();
@@ -390,23 +934,66 @@ int main(int argc, char** argv)
     ImGui::PushStyleColor(ImGuiCol_TitleBgActive, ImVec4(ImColor(94, 11, 22, 255)));
   }
 
-  // Apply the requested font size 
-  if (args.count("font_size"))
+  const auto clearColor = args.count("blended_background")
+    ? ImVec4{0.0f, 0.0f, 0.0f, 1.0f}
+    : takeOverWindowBackground(ImGui::GetStyle());
+
+  // When rendering at reduced resolution, everything needs to be scaled
+  // down accordingly. The font is rasterized at the size it ends up on
+  // screen, which looks a lot better than scaling down the full size
+  // glyphs.
+  const auto renderScale = args["render_scale"].as<float>();
+  if (renderScale != 1.0f)
   {
-    ImFontConfig config;
-    config.SizePixels = args["font_size"].as<int>();
-    ImGui::GetIO().Fonts->AddFontDefault(&config);
+    ImGui::GetStyle().ScaleAllSizes(renderScale);
   }
 
+  // Apply the requested font size. The built-in font is a bitmap font,
+  // so it's rasterized like AddFontDefault() does without a config: No
+  // oversampling, and glyphs snapped to whole pixels.
+  ImFontConfig config;
+  config.OversampleH = 1;
+  config.OversampleV = 1;
+  config.PixelSnapH = true;
+  if (args.count("font_size") || renderScale != 1.0f)
+  {
+    const auto fontSize = args.count("font_size")
+      ? float(args["font_size"].as<int>())
+      : defaultFontSize;
+    config.SizePixels = std::max(std::round(fontSize * renderScale), 1.0f);
+  }
+
+  io.Fonts->AddFontDefault(&config);
+
+  // Characters not covered by the default font are rasterized on demand
+  // from the --glyph_font, if given. This needs to reserve space in the
+  // atlas before it's built.
+  std::optional<GlyphCache> glyphCache;
+  if (args.count("glyph_font"))
+  {
+    glyphCache.emplace(*io.Fonts, args["glyph_font"].as<std::string>());
+  }
+
+  // Rasterize the font atlas now instead of letting the renderer backend
+  // do it, so that it can be loaded from/saved to the cache
+  loadOrBuildFontAtlas(*io.Fonts, cacheDirectory());
+
   // Setup Platform/Renderer bindings
   ImGui_ImplSDL2_InitForOpenGL(pWindow, pGlContext);
-  ImGui_ImplOpenGL3_Init(nullptr);
+  ImGui_ImplGLES2_Init(!args.count("rgba_atlas"));
 
   // Main loop
-  const auto exitCode = run(pWindow, args);
+  const auto exitCode =
+    run(pWindow, glyphCache ? &*glyphCache : nullptr, clearColor, args);
+
+  if (args.count("print_stats") || headless)
+  {
+    stats().fontTextureBytes = ImGui_ImplGLES2_GetFontTextureSize();
+    stats().print(std::cout);
+  }
 
   // Cleanup
-  ImGui_ImplOpenGL3_Shutdown();
+  ImGui_ImplGLES2_Shutdown();
   ImGui_ImplSDL2_Shutdown();
   ImGui::DestroyContext();
 
@@ -0,0 +1,141 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#include "monospace_grid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+float monospaceAdvance(const ImFont& font, const float fontSize)
+{
+  const auto advance = font.GetCharAdvance(' ');
+  for (auto c = ImWchar{0x21}; c < 0x7F; ++c)
+  {
+    const auto pGlyph = font.FindGlyphNoFallback(c);
+    if (!pGlyph || pGlyph->AdvanceX != advance)
+    {
+      return 0.0f;
+    }
+  }
+
+  return advance * fontSize / font.FontSize;
+}
+
+
+bool MonospaceGrid::setup(const ImFont& font, const float fontSize)
+{
+  mAdvance = monospaceAdvance(font, fontSize);
+  if (mAdvance <= 0.0f)
+  {
+    return false;
+  }
+
+  // Same vertex layout as ImDrawList::PrimRectUV(), which is what
+  // ImFont::RenderText() uses
+  const auto scale = fontSize / font.FontSize;
+  for (auto i = 0; i < charCount; ++i)
+  {
+    const auto& glyph = *font.FindGlyph(ImWchar(firstChar + i));
+    const auto x0 = glyph.X0 * scale;
+    const auto y0 = glyph.Y0 * scale;
+    const auto x1 = glyph.X1 * scale;
+    const auto y1 = glyph.Y1 * scale;
+
+    auto& quad = mQuads[i];
+    quad.visible = glyph.Visible;
+    quad.vertices[0] = {{x0, y0}, {glyph.U0, glyph.V0}, 0};
+    quad.vertices[1] = {{x1, y0}, {glyph.U1, glyph.V0}, 0};
+    quad.vertices[2] = {{x1, y1}, {glyph.U1, glyph.V1}, 0};
+    quad.vertices[3] = {{x0, y1}, {glyph.U0, glyph.V1}, 0};
+  }
+
+  return true;
+}
+
+
+std::pair<std::size_t, std::size_t> MonospaceGrid::visibleColumns(
+  const std::size_t columnCount,
+  const float minX,
+  const float maxX) const
+{
+  const auto first = std::min(
+    static_cast<std::size_t>(std::max(std::floor(minX / mAdvance), 0.0f)),
+    columnCount);
+  const auto last = std::min(
+    static_cast<std::size_t>(std::max(std::floor(maxX / mAdvance) + 1.0f, 0.0f)),
+    columnCount);
+  return {first, std::max(first, last)};
+}
+
+
+void MonospaceGrid::addRow(
+  ImDrawList& drawList,
+  const std::string_view row,
+  const ImVec2& pos,
+  const ImU32 color) const
+{
+  const auto maxQuads = int(row.size());
+  drawList.PrimReserve(maxQuads * 6, maxQuads * 4);
+
+  auto pVertex = drawList._VtxWritePtr;
+  auto pIndex = drawList._IdxWritePtr;
+  auto index = drawList._VtxCurrentIdx;
+
+  const auto x = std::floor(pos.x);
+  const auto y = std::floor(pos.y);
+
+  for (auto column = std::size_t{0}; column < row.size(); ++column)
+  {
+    const auto& quad = mQuads[std::uint8_t(row[column]) - firstChar];
+    if (!quad.visible)
+    {
+      continue;
+    }
+
+    const auto offsetX = x + column * mAdvance;
+    for (auto i = 0; i < 4; ++i)
+    {
+      pVertex[i] = quad.vertices[i];
+      pVertex[i].pos.x += offsetX;
+      pVertex[i].pos.y += y;
+      pVertex[i].col = color;
+    }
+
+    pIndex[0] = ImDrawIdx(index);
+    pIndex[1] = ImDrawIdx(index + 1);
+    pIndex[2] = ImDrawIdx(index + 2);
+    pIndex[3] = ImDrawIdx(index);
+    pIndex[4] = ImDrawIdx(index + 2);
+    pIndex[5] = ImDrawIdx(index + 3);
+
+    pVertex += 4;
+    pIndex += 6;
+    index += 4;
+  }
+
+  // Give back what we didn't need for blanks
+  const auto quadsWritten = int(pVertex - drawList._VtxWritePtr) / 4;
+  drawList._VtxWritePtr = pVertex;
+  drawList._IdxWritePtr = pIndex;
+  drawList._VtxCurrentIdx = index;
+  drawList.PrimUnreserve((maxQuads - quadsWritten) * 6, (maxQuads - quadsWritten) * 4);
+}
@@ -0,0 +1,98 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#pragma once
+
+#include "imgui.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+
+// True if text consists of printable ASCII characters only, i.e. no
+// control characters, tabs or multi-byte UTF-8 sequences. Such text can
+// be laid out on a monospace grid without looking at individual glyphs.
+inline bool isPrintableAscii(const std::string_view text)
+{
+  // Written without early exit so that the compiler can vectorize it
+  auto printable = true;
+  for (const auto c : text)
+  {
+    printable &= std::uint8_t(c - 0x20) < 0x5F;
+  }
+
+  return printable;
+}
+
+
+// Returns the advance shared by all printable ASCII glyphs of the given
+// font at the given size, or 0 if the font isn't monospaced.
+float monospaceAdvance(const ImFont& font, float fontSize);
+
+
+// Fast path for drawing printable ASCII text in a monospaced font.
+//
+// ImFont::RenderText() looks up every glyph, advances the pen position
+// glyph by glyph and clips each quad individually. With a fixed advance,
+// none of that is necessary: The position of a character is its column
+// times the advance, and the quad for each character can be prepared
+// up front. Drawing a row then boils down to copying the prepared vertices
+// into the draw list and offsetting them horizontally.
+class MonospaceGrid {
+public:
+  // Prepares the grid for the given font and size. Returns false (and
+  // disables the grid) if the font is not monospaced.
+  bool setup(const ImFont& font, float fontSize);
+
+  bool isEnabled() const { return mAdvance > 0.0f; }
+  float advance() const { return mAdvance; }
+
+  // Returns the range of columns [first, last) of a row with the given
+  // number of characters which overlaps [minX, maxX]
+  std::pair<std::size_t, std::size_t> visibleColumns(
+    std::size_t columnCount,
+    float minX,
+    float maxX) const;
+
+  // Draws the given row, which must satisfy isPrintableAscii(), with its
+  // first character at pos. Reserves space for row.size() quads.
+  void addRow(
+    ImDrawList& drawList,
+    std::string_view row,
+    const ImVec2& pos,
+    ImU32 color) const;
+
+private:
+  static constexpr auto firstChar = 0x20;
+  static constexpr auto charCount = 0x5F;
+
+  struct Quad
+  {
+    ImDrawVert vertices[4];
+    bool visible;
+  };
+
+  std::array<Quad, charCount> mQuads;
+  float mAdvance = 0.0f;
+};
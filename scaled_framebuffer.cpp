@@ -0,0 +1,172 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#include "scaled_framebuffer.hpp"
+
+#include "shader_program.hpp"
+
+#include <stdexcept>
+
+
+namespace
+{
+
+const char* vertexShaderSource = R"(
+  #version 100
+  attribute vec2 Position;
+  varying vec2 Frag_UV;
+
+  void main()
+  {
+    Frag_UV = Position;
+    gl_Position = vec4(Position * 2.0 - 1.0, 0.0, 1.0);
+  }
+)";
+
+
+const char* fragmentShaderSource = R"(
+  #version 100
+  precision mediump float;
+  uniform sampler2D Texture;
+  varying vec2 Frag_UV;
+
+  void main()
+  {
+    gl_FragColor = texture2D(Texture, Frag_UV.st);
+  }
+)";
+
+}
+
+
+ScaledFramebuffer::ScaledFramebuffer()
+  : mProgram(createShaderProgram(vertexShaderSource, fragmentShaderSource))
+  , mTextureLocation(glGetUniformLocation(mProgram, "Texture"))
+  , mQuadBuffer(0)
+  , mTexture(0)
+  , mFramebuffer(0)
+  , mWidth(0)
+  , mHeight(0)
+{
+  // A unit square, covering the whole window after transforming it in
+  // the vertex shader
+  const float quad[] = {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f};
+  glGenBuffers(1, &mQuadBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, mQuadBuffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+}
+
+
+ScaledFramebuffer::~ScaledFramebuffer()
+{
+  release();
+  glDeleteBuffers(1, &mQuadBuffer);
+  glDeleteProgram(mProgram);
+}
+
+
+void ScaledFramebuffer::bind(const int width, const int height)
+{
+  if (width != mWidth || height != mHeight)
+  {
+    release();
+
+    glGenTextures(1, &mTexture);
+    glBindTexture(GL_TEXTURE_2D, mTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(
+      GL_TEXTURE_2D,
+      0,
+      GL_RGB,
+      width,
+      height,
+      0,
+      GL_RGB,
+      GL_UNSIGNED_BYTE,
+      nullptr);
+
+    glGenFramebuffers(1, &mFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    glFramebufferTexture2D(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      release();
+      throw std::runtime_error("Failed to create scaled framebuffer");
+    }
+
+    mWidth = width;
+    mHeight = height;
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+}
+
+
+void ScaledFramebuffer::present(const int windowWidth, const int windowHeight)
+{
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, windowWidth, windowHeight);
+
+  // Every pixel gets overwritten, so there's no need to clear or blend
+  glDisable(GL_BLEND);
+  glDisable(GL_SCISSOR_TEST);
+
+  glUseProgram(mProgram);
+  glUniform1i(mTextureLocation, 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, mTexture);
+
+  GLint maxAttributes = 0;
+  glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &maxAttributes);
+  for (auto i = 0; i < maxAttributes; ++i)
+  {
+    glDisableVertexAttribArray(i);
+  }
+
+  glEnableVertexAttribArray(positionAttribute);
+  glBindBuffer(GL_ARRAY_BUFFER, mQuadBuffer);
+  glVertexAttribPointer(positionAttribute, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+
+void ScaledFramebuffer::release()
+{
+  if (mFramebuffer)
+  {
+    glDeleteFramebuffers(1, &mFramebuffer);
+    mFramebuffer = 0;
+  }
+
+  if (mTexture)
+  {
+    glDeleteTextures(1, &mTexture);
+    mTexture = 0;
+  }
+
+  mWidth = 0;
+  mHeight = 0;
+}
@@ -0,0 +1,61 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#pragma once
+
+#include <GLES2/gl2.h>
+
+
+// An offscreen framebuffer which the UI can be rendered into at reduced
+// resolution, and which is then scaled up to fill the window.
+//
+// Some devices drive high resolution displays from GPUs that can't fill
+// every pixel with several layers of blended UI at a good frame rate.
+// Rendering at a lower resolution and scaling up in a single pass
+// reduces the number of pixels the UI needs to touch.
+class ScaledFramebuffer {
+public:
+  ScaledFramebuffer();
+  ~ScaledFramebuffer();
+
+  ScaledFramebuffer(const ScaledFramebuffer&) = delete;
+  ScaledFramebuffer& operator=(const ScaledFramebuffer&) = delete;
+
+  // Binds the offscreen framebuffer for rendering, (re-)creating it if
+  // it doesn't have the given size yet.
+  void bind(int width, int height);
+
+  // Binds the default framebuffer, and draws the offscreen framebuffer's
+  // content stretched to the given size.
+  void present(int windowWidth, int windowHeight);
+
+private:
+  void release();
+
+  GLuint mProgram;
+  GLint mTextureLocation;
+  GLuint mQuadBuffer;
+
+  GLuint mTexture;
+  GLuint mFramebuffer;
+  int mWidth;
+  int mHeight;
+};
@@ -0,0 +1,477 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#include "script_reader.hpp"
+
+#include "stats.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+
+
+namespace
+{
+
+std::vector<std::string> scriptCommand(
+  const std::string& scriptFile,
+  const bool runViaShell)
+{
+  if (runViaShell)
+  {
+    return {"/bin/sh", "-c", scriptFile};
+  }
+
+  return {scriptFile};
+}
+
+
+int openLogFile(const std::string& logFile)
+{
+  if (logFile.empty())
+  {
+    return -1;
+  }
+
+  const auto fd =
+    open(logFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd == -1)
+  {
+    throw std::runtime_error("Failed to open log file " + logFile);
+  }
+
+  return fd;
+}
+
+
+// Both ends are close-on-exec, so that the script doesn't inherit them
+void createPipe(FileDescriptor (&pipe)[2], const char* pErrorMessage)
+{
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) == -1)
+  {
+    throw std::runtime_error(pErrorMessage);
+  }
+
+  pipe[0].reset(fds[0]);
+  pipe[1].reset(fds[1]);
+}
+
+}
+
+
+ScriptReader::ScriptReader(
+  const std::string& scriptFile,
+  const bool runViaShell,
+  const bool usePseudoterminal,
+  const std::string& logFile,
+  const Uint32 wakeupEventType)
+  : mLogFd(openLogFile(logFile))
+  , mStartTime(Clock::now())
+  , mProcess(scriptCommand(scriptFile, runViaShell), usePseudoterminal)
+  , mWakeupEventType(wakeupEventType)
+  , mSpliceToLog(true)
+  , mLogFailed(false)
+  , mFinished(false)
+  , mReadFailed(false)
+  , mFirstOutputReported(false)
+  , mWakeupPending(false)
+  , mStopRequested(false)
+{
+  stats().scriptSpawnMs =
+    std::chrono::duration<double, std::milli>(Clock::now() - mStartTime).count();
+
+  // We read until a stream is empty and then go back to poll(), so that
+  // we can also react to output on the other one, or to being stopped.
+  // Reading mustn't block for that.
+  for (const auto fd : {mProcess.stdoutFd(), mProcess.stderrFd()})
+  {
+    const auto flags = fcntl(fd, F_GETFL);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+    {
+      throw std::runtime_error("Failed to make script fd non-blocking");
+    }
+  }
+
+  createPipe(mStopPipe, "Failed to create reader stop pipe");
+
+  if (mLogFd.valid())
+  {
+    createPipe(mLogPipe, "Failed to create log pipe");
+  }
+
+  mThread = std::thread([this]() { run(); });
+}
+
+
+ScriptReader::~ScriptReader()
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStopRequested = true;
+  }
+
+  // Wake up the thread, no matter if it's waiting for a free chunk or
+  // sitting in poll()
+  mChunkFreed.notify_one();
+  const char stopByte = 0;
+  [[maybe_unused]] const auto ignored = write(mStopPipe[1].get(), &stopByte, 1);
+
+  mThread.join();
+}
+
+
+bool ScriptReader::consumeOutput(
+  const OutputHandler& handler,
+  const Clock::time_point deadline)
+{
+  // Anything the reader thread publishes from now on needs a new wakeup.
+  // The fence pairs with the one in run(), so that either we see the new
+  // chunk below, or the reader thread sees the cleared flag.
+  mWakeupPending.store(false);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  // The reader thread sets this after publishing its last chunk, so if
+  // it's set, the loop below is guaranteed to see all chunks
+  const auto finished = mFinished.load(std::memory_order_acquire);
+
+  auto chunksConsumed = false;
+  while (const auto pChunk = mChunks.beginRead())
+  {
+    if (!mFirstOutputReported)
+    {
+      stats().scriptFirstOutputMs = std::chrono::duration<double, std::milli>(
+        mFirstOutputTime - mStartTime).count();
+      mFirstOutputReported = true;
+    }
+
+    stats().scriptOutputLag.add(std::chrono::duration<double, std::milli>(
+      Clock::now() - pChunk->mPublishTime).count());
+
+    handler(
+      {pChunk->mData.data(), pChunk->mSize},
+      pChunk->mFromStderr,
+      pChunk->mPublishTime);
+    mChunks.commitRead();
+    chunksConsumed = true;
+
+    if (Clock::now() >= deadline)
+    {
+      break;
+    }
+  }
+
+  if (chunksConsumed)
+  {
+    // The reader thread might be waiting for room in the ring
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+    }
+    mChunkFreed.notify_one();
+  }
+
+  if (mChunks.beginRead())
+  {
+    wakeUpConsumer();
+    return true;
+  }
+
+  if (finished && mReadFailed.load())
+  {
+    throw std::runtime_error("Error read()-ing script fd");
+  }
+
+  return !finished;
+}
+
+
+void ScriptReader::run()
+{
+  // Output is gathered in a chunk until it's full, until there's nothing
+  // more to read for the moment, or until output arrives on the other
+  // stream. Only then the chunk is handed over, so that chunks are well
+  // filled when the script produces a lot of output, but there is no
+  // delay when it doesn't.
+  Chunk* pChunk = nullptr;
+  auto publishChunk = [&]()
+  {
+    if (pChunk && pChunk->mSize > 0)
+    {
+      pChunk->mPublishTime = Clock::now();
+      mChunks.commitWrite();
+      pChunk = nullptr;
+
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      wakeUpConsumer();
+    }
+  };
+
+  // Reads from stdout or stderr until there's nothing left for the
+  // moment. The fd is set to -1 once the script has closed the stream.
+  // Returns false if we need to stop.
+  auto readAvailable = [&](int& fd, const bool fromStderr, bool& canSplice)
+  {
+    for (;;)
+    {
+      if (pChunk && pChunk->mFromStderr != fromStderr)
+      {
+        publishChunk();
+      }
+
+      if (!pChunk)
+      {
+        if (!waitForFreeChunk())
+        {
+          return false;
+        }
+
+        pChunk = mChunks.beginWrite();
+        pChunk->mSize = 0;
+        pChunk->mFromStderr = fromStderr;
+      }
+
+      const auto bytesRead = readAndLog(
+        fd,
+        pChunk->mData.data() + pChunk->mSize,
+        pChunk->mData.size() - pChunk->mSize,
+        canSplice);
+      if (bytesRead > 0)
+      {
+        if (mFirstOutputTime == Clock::time_point{})
+        {
+          mFirstOutputTime = Clock::now();
+        }
+
+        pChunk->mSize += std::size_t(bytesRead);
+        if (pChunk->mSize == pChunk->mData.size())
+        {
+          publishChunk();
+        }
+      }
+      else if (bytesRead == 0 || errno == EIO)
+      {
+        // The stream was closed. A pseudoterminal reports this as EIO.
+        fd = -1;
+        return true;
+      }
+      else if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        return true;
+      }
+      else if (errno != EINTR)
+      {
+        mReadFailed = true;
+        fd = -1;
+        return true;
+      }
+    }
+  };
+
+  int fds[2] = {mProcess.stdoutFd(), mProcess.stderrFd()};
+  bool canSplice[2] = {true, true};
+  while (fds[0] != -1 || fds[1] != -1)
+  {
+    // Wait for more output, or for being stopped. poll() ignores
+    // negative fds, i.e. streams which are closed already.
+    struct pollfd pollData[3]{
+      {fds[0], POLLIN, 0},
+      {fds[1], POLLIN, 0},
+      {mStopPipe[0].get(), POLLIN, 0}};
+    const auto result = poll(pollData, 3, -1);
+
+    if (result < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+
+      mReadFailed = true;
+      break;
+    }
+
+    if (pollData[2].revents)
+    {
+      return;
+    }
+
+    for (auto i = 0; i < 2; ++i)
+    {
+      if (pollData[i].revents && !readAvailable(fds[i], i == 1, canSplice[i]))
+      {
+        return;
+      }
+    }
+
+    publishChunk();
+  }
+
+  publishChunk();
+
+  mFinished.store(true, std::memory_order_release);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  wakeUpConsumer();
+}
+
+
+bool ScriptReader::waitForFreeChunk()
+{
+  // Only touch the mutex if we actually need to wait. A stop request
+  // is also noticed in poll(), or once the ring runs full at the latest.
+  if (!mChunks.full())
+  {
+    return true;
+  }
+
+  std::unique_lock<std::mutex> lock(mMutex);
+  mChunkFreed.wait(
+    lock, [this]() { return mStopRequested || !mChunks.full(); });
+  return !mStopRequested;
+}
+
+
+void ScriptReader::wakeUpConsumer()
+{
+  if (!mWakeupPending.exchange(true))
+  {
+    // SDL_PushEvent is safe to call from other threads
+    SDL_Event event{};
+    event.type = mWakeupEventType;
+    SDL_PushEvent(&event);
+  }
+}
+
+
+ssize_t ScriptReader::readAndLog(
+  const int fd,
+  char* const pBuffer,
+  const std::size_t size,
+  bool& canSplice)
+{
+  if (!mLogFd.valid() || mLogFailed.load(std::memory_order_relaxed))
+  {
+    return read(fd, pBuffer, size);
+  }
+
+  // tee() duplicates what's in the pipe into our log pipe, without
+  // consuming it. We then read exactly that much, and let the kernel move
+  // the duplicate on to the file. Only pipes support this, so for a
+  // pseudoterminal, we fall back to writing the file ourselves.
+  if (canSplice && mSpliceToLog)
+  {
+    const auto bytesTeed = tee(fd, mLogPipe[1].get(), size, SPLICE_F_NONBLOCK);
+    if (bytesTeed > 0)
+    {
+      // The data is in the pipe already, so this gets all of it
+      const auto bytesRead = read(fd, pBuffer, std::size_t(bytesTeed));
+      if (bytesRead <= 0)
+      {
+        return bytesRead;
+      }
+
+      auto bytesSpliced = ssize_t{0};
+      while (bytesSpliced < bytesTeed)
+      {
+        const auto result = splice(
+          mLogPipe[0].get(),
+          nullptr,
+          mLogFd.get(),
+          nullptr,
+          std::size_t(bytesTeed - bytesSpliced),
+          SPLICE_F_MOVE);
+        if (result > 0)
+        {
+          bytesSpliced += result;
+        }
+        else if (result == -1 && errno == EINVAL)
+        {
+          // The file doesn't support splice(). We have the data anyway, so
+          // we write it ourselves, and throw away the duplicate.
+          mSpliceToLog = false;
+          writeToLog(pBuffer + bytesSpliced, std::size_t(bytesTeed - bytesSpliced));
+
+          char discarded[4096];
+          for (auto left = bytesTeed - bytesSpliced; left > 0; )
+          {
+            const auto result = read(
+              mLogPipe[0].get(),
+              discarded,
+              std::min(std::size_t(left), sizeof(discarded)));
+            if (result > 0)
+            {
+              left -= result;
+            }
+            else if (errno != EINTR)
+            {
+              break;
+            }
+          }
+          break;
+        }
+        else if (result == 0 || errno != EINTR)
+        {
+          mLogFailed = true;
+          break;
+        }
+      }
+
+      return bytesRead;
+    }
+
+    if (bytesTeed == 0 || errno != EINVAL)
+    {
+      return bytesTeed;
+    }
+
+    canSplice = false;
+  }
+
+  const auto bytesRead = read(fd, pBuffer, size);
+  if (bytesRead > 0)
+  {
+    writeToLog(pBuffer, std::size_t(bytesRead));
+  }
+
+  return bytesRead;
+}
+
+
+void ScriptReader::writeToLog(const char* pData, std::size_t size)
+{
+  while (size > 0)
+  {
+    const auto bytesWritten = write(mLogFd.get(), pData, size);
+    if (bytesWritten > 0)
+    {
+      pData += bytesWritten;
+      size -= std::size_t(bytesWritten);
+    }
+    else if (errno != EINTR)
+    {
+      mLogFailed = true;
+      return;
+    }
+  }
+}
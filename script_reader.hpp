@@ -0,0 +1,158 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#pragma once
+
+#include "child_process.hpp"
+#include "file_descriptor.hpp"
+#include "spsc_ring.hpp"
+
+#include <SDL.h>
+
+#include <sys/types.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+
+// Runs a script, and reads its output on a background thread. stdout
+// and stderr are read separately, so that the UI can tell them apart. The
+// output is handed over to the UI thread in chunks via a lock-free ring,
+// so reading keeps up with the script no matter how fast we are able to
+// render. Whenever new output is available, an SDL user event of the
+// given type is pushed, to wake up the main loop.
+//
+// If the UI thread falls behind so much that the ring fills up, the
+// reader thread stops reading until there is room again. The script then
+// blocks once the pipe is full, as it would without the ring.
+//
+// Optionally, the output of both streams is also written to a log file,
+// in the order in which it's handed over to the UI thread. Whatever the UI
+// thread gets is in the file already. For output arriving via a pipe, the
+// kernel copies the data to the file (via tee() and splice()), so this
+// costs hardly anything on top of reading it.
+class ScriptReader {
+public:
+  using Clock = std::chrono::steady_clock;
+  using OutputHandler = std::function<void(
+    std::string_view output,
+    bool fromStderr,
+    Clock::time_point arrivalTime)>;
+
+  // The script is started directly, unless runViaShell is set. In that
+  // case, the script file is treated as a shell command line, which makes
+  // it possible to pass arguments etc. at the cost of slower startup.
+  // With usePseudoterminal, the script's output goes to a pseudoterminal,
+  // see ChildProcess. If logFile isn't empty, the output is written to
+  // that file, replacing its previous content.
+  ScriptReader(
+    const std::string& scriptFile,
+    bool runViaShell,
+    bool usePseudoterminal,
+    const std::string& logFile,
+    Uint32 wakeupEventType);
+  ~ScriptReader();
+
+  ScriptReader(const ScriptReader&) = delete;
+  ScriptReader& operator=(const ScriptReader&) = delete;
+
+  // Passes the output received so far to the given handler, one chunk at
+  // a time, until there is none left or the deadline has passed. The
+  // arrival time is when the reader thread received the chunk. Anything
+  // left over causes another wakeup event, so it's picked up in the next
+  // frame. Returns false once the script has exited and all of its output
+  // has been consumed. To be called on the UI thread only.
+  bool consumeOutput(const OutputHandler& handler, Clock::time_point deadline);
+
+  // When the script was started
+  Clock::time_point startTime() const { return mStartTime; }
+
+  // True if writing the log file failed, it's incomplete in that case
+  bool logFailed() const { return mLogFailed.load(); }
+
+private:
+  static constexpr auto chunkSize = std::size_t{16 * 1024};
+  static constexpr auto chunkCount = std::size_t{128};
+
+  struct Chunk
+  {
+    std::size_t mSize;
+    bool mFromStderr;
+
+    // When the reader thread handed the chunk over
+    Clock::time_point mPublishTime;
+    std::array<char, chunkSize> mData;
+  };
+
+  void run();
+  bool waitForFreeChunk();
+  void wakeUpConsumer();
+  ssize_t readAndLog(int fd, char* pBuffer, std::size_t size, bool& canSplice);
+  void writeToLog(const char* pData, std::size_t size);
+
+  // The log file is opened before starting the script, so that failing to
+  // open it doesn't leave us waiting for the script to finish
+  FileDescriptor mLogFd;
+
+  Clock::time_point mStartTime;
+  ChildProcess mProcess;
+  FileDescriptor mStopPipe[2];
+  Uint32 mWakeupEventType;
+
+  // Output from a pipe is copied to the log via this pipe, see
+  // readAndLog(). It only holds data for as long as it takes to move it on
+  // to the file. Only used by the reader thread, like mSpliceToLog, which
+  // is cleared if the file doesn't support splice().
+  FileDescriptor mLogPipe[2];
+  bool mSpliceToLog;
+  std::atomic<bool> mLogFailed;
+
+  SpscRing<Chunk, chunkCount> mChunks;
+
+  // Set by the reader thread once it's done, after publishing the last
+  // chunk
+  std::atomic<bool> mFinished;
+  std::atomic<bool> mReadFailed;
+
+  // Set by the reader thread before publishing the first chunk, and
+  // reported in the statistics by the UI thread once it got that chunk
+  Clock::time_point mFirstOutputTime;
+  bool mFirstOutputReported;
+
+  // Avoids flooding the event queue with wakeup events while the UI
+  // thread hasn't gotten around to handling the previous one yet
+  std::atomic<bool> mWakeupPending;
+
+  // Only used when the ring is full, to let the reader thread sleep until
+  // the UI thread has made room
+  std::mutex mMutex;
+  std::condition_variable mChunkFreed;
+  bool mStopRequested;
+
+  std::thread mThread;
+};
@@ -0,0 +1,81 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#include "shader_program.hpp"
+
+#include <stdexcept>
+#include <string>
+
+
+namespace
+{
+
+GLuint compileShader(const GLenum type, const char* source)
+{
+  const auto shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, nullptr);
+  glCompileShader(shader);
+
+  GLint status = GL_FALSE;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+  if (status != GL_TRUE)
+  {
+    char log[512] = {};
+    glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+    glDeleteShader(shader);
+    throw std::runtime_error(std::string{"Failed to compile shader: "} + log);
+  }
+
+  return shader;
+}
+
+}
+
+
+GLuint createShaderProgram(
+  const char* vertexShaderSource,
+  const char* fragmentShaderSource)
+{
+  const auto vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSource);
+  const auto fragmentShader =
+    compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+
+  const auto program = glCreateProgram();
+  glAttachShader(program, vertexShader);
+  glAttachShader(program, fragmentShader);
+  glBindAttribLocation(program, positionAttribute, "Position");
+  glBindAttribLocation(program, uvAttribute, "UV");
+  glBindAttribLocation(program, colorAttribute, "Color");
+  glLinkProgram(program);
+
+  glDeleteShader(vertexShader);
+  glDeleteShader(fragmentShader);
+
+  GLint status = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if (status != GL_TRUE)
+  {
+    glDeleteProgram(program);
+    throw std::runtime_error("Failed to link shader program");
+  }
+
+  return program;
+}
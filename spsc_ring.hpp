@@ -0,0 +1,101 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+
+// Fixed-size ring of slots, for handing data from one thread (the
+// producer) to exactly one other thread (the consumer) without locking.
+// Slots are filled and read in place, so nothing is copied or allocated
+// when passing data around - only the read and write positions are
+// published to the other thread.
+//
+// The producer calls beginWrite() to get a free slot, fills it, and then
+// makes it visible to the consumer via commitWrite(). The consumer does
+// the same with beginRead() and commitRead(), after which the slot can
+// be reused by the producer.
+template <typename T, std::size_t Capacity>
+class SpscRing {
+public:
+  static_assert(
+    Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+    "Capacity must be a power of two");
+
+  // Producer side. Returns nullptr if all slots are in use.
+  T* beginWrite()
+  {
+    const auto writePos = mWritePos.load(std::memory_order_relaxed);
+    if (writePos - mReadPos.load(std::memory_order_acquire) == Capacity)
+    {
+      return nullptr;
+    }
+
+    return &mSlots[writePos % Capacity];
+  }
+
+  void commitWrite()
+  {
+    mWritePos.store(
+      mWritePos.load(std::memory_order_relaxed) + 1,
+      std::memory_order_release);
+  }
+
+  // Consumer side. Returns nullptr if there's nothing to read.
+  T* beginRead()
+  {
+    const auto readPos = mReadPos.load(std::memory_order_relaxed);
+    if (readPos == mWritePos.load(std::memory_order_acquire))
+    {
+      return nullptr;
+    }
+
+    return &mSlots[readPos % Capacity];
+  }
+
+  void commitRead()
+  {
+    mReadPos.store(
+      mReadPos.load(std::memory_order_relaxed) + 1,
+      std::memory_order_release);
+  }
+
+  // Can be called from either side
+  bool full() const
+  {
+    return
+      mWritePos.load(std::memory_order_acquire) -
+      mReadPos.load(std::memory_order_acquire) == Capacity;
+  }
+
+private:
+  std::array<T, Capacity> mSlots;
+
+  // Positions only ever increase, the slot index is taken modulo the
+  // capacity. Each one is written by one side only, and they are kept on
+  // separate cache lines so that the two threads don't slow each other
+  // down.
+  alignas(64) std::atomic<std::size_t> mWritePos{0};
+  alignas(64) std::atomic<std::size_t> mReadPos{0};
+};
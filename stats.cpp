@@ -0,0 +1,140 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#include "stats.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+
+void TimeHistogram::add(const double milliseconds)
+{
+  const auto bucket = std::min(
+    static_cast<std::size_t>(std::max(milliseconds, 0.0) * bucketsPerMs),
+    mBuckets.size() - 1);
+  ++mBuckets[bucket];
+
+  ++mCount;
+  mSum += milliseconds;
+  mMax = std::max(mMax, milliseconds);
+}
+
+
+double TimeHistogram::percentile(const double fraction) const
+{
+  const auto target = static_cast<std::uint64_t>(fraction * mCount);
+
+  auto seen = std::uint64_t{0};
+  for (auto i = std::size_t{0}; i < mBuckets.size(); ++i)
+  {
+    seen += mBuckets[i];
+    if (seen > target)
+    {
+      // Report the upper end of the bucket
+      return std::min(double(i + 1) / bucketsPerMs, mMax);
+    }
+  }
+
+  return mMax;
+}
+
+
+void TimeHistogram::print(std::ostream& stream, const char* name) const
+{
+  if (mCount == 0)
+  {
+    stream << name << ": no samples\n";
+    return;
+  }
+
+  stream
+    << std::fixed << std::setprecision(2)
+    << name << " (ms): mean " << mSum / mCount
+    << ", p50 " << percentile(0.5)
+    << ", p90 " << percentile(0.9)
+    << ", p99 " << percentile(0.99)
+    << ", max " << mMax
+    << " (" << mCount << " samples)\n";
+
+  // Coarse distribution, with boundaries around common refresh rates
+  constexpr double boundaries[] = {0.0, 8.5, 12.5, 17.0, 25.0, 34.0, 50.0, 100.0};
+  for (auto i = std::size_t{0}; i < std::size(boundaries); ++i)
+  {
+    const auto begin = static_cast<std::size_t>(boundaries[i] * bucketsPerMs);
+    const auto end = i + 1 < std::size(boundaries)
+      ? static_cast<std::size_t>(boundaries[i + 1] * bucketsPerMs)
+      : mBuckets.size();
+
+    auto count = std::uint64_t{0};
+    for (auto bucket = begin; bucket < end; ++bucket)
+    {
+      count += mBuckets[bucket];
+    }
+
+    stream << "  " << std::setw(6) << boundaries[i] << " - ";
+    if (i + 1 < std::size(boundaries))
+    {
+      stream << std::setw(6) << boundaries[i + 1];
+    }
+    else
+    {
+      stream << "      ";
+    }
+
+    stream
+      << ": " << std::setw(5) << 100.0 * count / mCount << "% ("
+      << count << ")\n";
+  }
+
+  stream << std::defaultfloat;
+}
+
+
+void Stats::print(std::ostream& stream) const
+{
+  stream
+    << "Frames built:     " << builtFrames << '\n'
+    << "Frames presented: " << presentedFrames << '\n'
+    << "Frames skipped:   " << skippedFrames << '\n'
+    << "Text pages built: " << textPagesBuilt << '\n'
+    << "Text tiles:       " << textTilesRendered << " rendered\n"
+    << "Glyphs cached:    " << glyphsRasterized
+    << " (" << glyphsEvicted << " evicted)\n"
+    << std::fixed << std::setprecision(2)
+    << "Font atlas (ms):  " << fontAtlasMs
+    << (fontAtlasFromCache ? " (cached)" : " (built)") << '\n'
+    << "Font texture:     " << fontTextureBytes / 1024 << " KiB\n"
+    << "Script start:     " << scriptSpawnMs << " ms, first output after "
+    << scriptFirstOutputMs << " ms\n"
+    << "Script output:    " << scriptBytesRead / 1024 << " KiB, appended in "
+    << scriptReadMs << " ms\n"
+    << std::defaultfloat;
+  frameTimes.print(stream, "Frame times");
+  inputLatency.print(stream, "Input latency");
+  scriptOutputLag.print(stream, "Output lag");
+}
+
+
+Stats& stats()
+{
+  static Stats instance;
+  return instance;
+}
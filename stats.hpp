@@ -0,0 +1,112 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+
+// Records the distribution of durations like frame times, with a
+// resolution of a quarter millisecond. Everything above 100 ms goes into a
+// single bucket.
+class TimeHistogram
+{
+public:
+  void add(double milliseconds);
+  void print(std::ostream& stream, const char* name) const;
+
+private:
+  static constexpr auto bucketsPerMs = 4;
+  static constexpr auto maxMs = 100;
+
+  double percentile(double fraction) const;
+
+  std::array<std::uint64_t, bucketsPerMs * maxMs + 1> mBuckets{};
+  std::uint64_t mCount = 0;
+  double mSum = 0.0;
+  double mMax = 0.0;
+};
+
+
+// Counters collected while running. They are printed on exit when the
+// -p/--print_stats option is given, which allows checking things like
+// power savings on the target device.
+struct Stats
+{
+  // Frames for which the UI was built (ImGui::NewFrame() to Render())
+  std::uint64_t builtFrames = 0;
+
+  // Frames which were actually drawn and presented
+  std::uint64_t presentedFrames = 0;
+
+  // Frames which were not presented because they would have looked
+  // exactly like the previously presented one
+  std::uint64_t skippedFrames = 0;
+
+  // Pages of text for which vertex data was generated
+  std::uint64_t textPagesBuilt = 0;
+
+  // Tiles of text rendered into textures, when using the tile cache
+  std::uint64_t textTilesRendered = 0;
+
+  // Glyphs rasterized on demand by the glyph cache, and glyphs which had
+  // to make room for others
+  std::uint64_t glyphsRasterized = 0;
+  std::uint64_t glyphsEvicted = 0;
+
+  // Time it took to get the font atlas ready at startup, and whether it
+  // was loaded from the on-disk cache
+  double fontAtlasMs = 0.0;
+  bool fontAtlasFromCache = false;
+
+  // GPU memory taken up by the font texture
+  std::size_t fontTextureBytes = 0;
+
+  // Time it took to start the script, and time from starting it until
+  // its first output arrived
+  double scriptSpawnMs = 0.0;
+  double scriptFirstOutputMs = 0.0;
+
+  // Output received from the script, and time the UI thread spent adding
+  // it to the text. Reading happens on a separate thread.
+  std::uint64_t scriptBytesRead = 0;
+  double scriptReadMs = 0.0;
+
+  // Time between the starts of consecutive frames, while rendering
+  // continuously. Time spent idle is not included.
+  TimeHistogram frameTimes;
+
+  // Time from an input event until the frame reacting to it was submitted
+  TimeHistogram inputLatency;
+
+  // Time script output waited to be taken in by the UI thread after the
+  // reader thread received it
+  TimeHistogram scriptOutputLag;
+
+  void print(std::ostream& stream) const;
+};
+
+
+// Returns the global statistics instance
+Stats& stats();
@@ -0,0 +1,469 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+
+#include "text_buffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+
+TextBuffer::TextBuffer(std::string_view text)
+{
+  append(text);
+}
+
+
+void TextBuffer::setLimits(const std::size_t maxLines, const std::size_t maxBytes)
+{
+  mMaxLines = maxLines;
+  mMaxBytes = maxBytes;
+  mRestoredLines = 0;
+  mRestoredBytes = 0;
+  dropLines();
+}
+
+
+void TextBuffer::prepend(
+  const TextBuffer& other,
+  const std::size_t first,
+  const std::size_t end)
+{
+  const auto count = end - first;
+  if (count == 0 || mFirstLine < count || mLines.empty())
+  {
+    return;
+  }
+
+  ++mRevision;
+
+  auto byteCount = std::size_t{0};
+  auto spanCount = std::size_t{0};
+  for (auto i = first; i < end; ++i)
+  {
+    const auto spans = other.colorSpans(i);
+    byteCount += other.line(i).size();
+    spanCount += std::size_t(std::distance(spans.begin(), spans.end()));
+  }
+
+  // Span indices are counted from the first span ever added. If the lines
+  // dropped before had fewer spans than the ones we restore, all indices
+  // need to move up to make room.
+  if (mFirstSpan < spanCount)
+  {
+    const auto shift = spanCount - mFirstSpan;
+    for (auto& line : mLines)
+    {
+      line.firstSpan += shift;
+    }
+
+    mFirstSpan += shift;
+  }
+
+  // All restored text goes into a chunk of its own, in front of the others
+  auto chunk = Chunk{
+    std::unique_ptr<char[]>(new char[byteCount]),
+    byteCount,
+    byteCount,
+    mFirstLine};
+
+  auto pText = chunk.pData.get() + byteCount;
+  for (auto i = end; i > first; --i)
+  {
+    const auto line = other.line(i - 1);
+    if (!line.empty())
+    {
+      pText -= line.size();
+      std::memcpy(pText, line.data(), line.size());
+    }
+
+    const auto spans = other.colorSpans(i - 1);
+    for (auto iSpan = spans.end(); iSpan != spans.begin(); )
+    {
+      mColorSpans.push_front(*--iSpan);
+      --mFirstSpan;
+    }
+
+    mLines.push_front(
+      {line.empty() ? nullptr : pText,
+       std::uint32_t(line.size()),
+       mRevision,
+       mFirstSpan});
+    mLineFlags.push_front(other.lineFlags(i - 1));
+  }
+
+  if (byteCount > 0)
+  {
+    mChunks.push_front(std::move(chunk));
+  }
+
+  mFirstLine -= count;
+  mByteCount += byteCount;
+  mRestoredLines += count;
+  mRestoredBytes += byteCount;
+}
+
+
+void TextBuffer::replace(TextBuffer&& other)
+{
+  const auto revision = std::max(mRevision, other.mRevision) + 1;
+
+  const auto sameSpans = [&](const std::size_t i)
+  {
+    const auto spans = colorSpans(i);
+    const auto otherSpans = other.colorSpans(i);
+    return std::equal(
+      spans.begin(), spans.end(),
+      otherSpans.begin(), otherSpans.end(),
+      [](const ColorSpan& a, const ColorSpan& b)
+      {
+        return a.begin == b.begin && a.color == b.color;
+      });
+  };
+
+  for (auto i = other.firstLine(); i < other.endLine(); ++i)
+  {
+    const auto unchanged =
+      i >= firstLine() &&
+      i < endLine() &&
+      line(i) == other.line(i) &&
+      lineFlags(i) == other.lineFlags(i) &&
+      sameSpans(i);
+
+    other.mLines[i - other.mFirstLine].revision =
+      unchanged ? lineRevision(i) : revision;
+  }
+
+  other.mRevision = revision;
+  other.mReplacedRevision = revision;
+  *this = std::move(other);
+}
+
+
+void TextBuffer::append(
+  std::string_view data,
+  const std::uint8_t lineFlags,
+  const std::uint32_t color)
+{
+  if (data.empty())
+  {
+    return;
+  }
+
+  ++mRevision;
+
+  while (!data.empty())
+  {
+    auto& line = modifyLastLine(lineFlags);
+
+    const auto lineEnd = data.find('\n');
+    const auto part = data.substr(0, lineEnd);
+    if (!part.empty())
+    {
+      const auto lineHasSpans = mFirstSpan + mColorSpans.size() > line.firstSpan;
+      const auto currentColor =
+        lineHasSpans ? mColorSpans.back().color : defaultColor;
+      if (color != currentColor)
+      {
+        mColorSpans.push_back({line.size, color});
+      }
+
+      std::memcpy(reserveForLastLine(part.size()), part.data(), part.size());
+      line.size += std::uint32_t(part.size());
+      mByteCount += part.size();
+    }
+
+    if (lineEnd == std::string_view::npos)
+    {
+      break;
+    }
+
+    mLastLineComplete = true;
+    data.remove_prefix(lineEnd + 1);
+  }
+
+  dropLines();
+}
+
+
+void TextBuffer::write(
+  const std::size_t position,
+  const std::string_view data,
+  const std::uint8_t lineFlags,
+  const std::uint32_t color)
+{
+  if (data.empty())
+  {
+    return;
+  }
+
+  ++mRevision;
+  auto& line = modifyLastLine(lineFlags);
+
+  if (position > line.size)
+  {
+    const auto gap = position - line.size;
+    std::memset(reserveForLastLine(gap), ' ', gap);
+    line.size += std::uint32_t(gap);
+    mByteCount += gap;
+  }
+
+  // Find the end of the characters being replaced, skipping one character
+  // in the line for each one in data
+  const auto text = std::string_view{line.pText, line.size};
+  const auto isContinuationByte = [](const char c)
+  {
+    return (std::uint8_t(c) & 0xC0) == 0x80;
+  };
+
+  auto end = position;
+  for (const auto c : data)
+  {
+    if (!isContinuationByte(c) && end < text.size())
+    {
+      ++end;
+      while (end < text.size() && isContinuationByte(text[end]))
+      {
+        ++end;
+      }
+    }
+  }
+
+  replaceColorInLastLine(position, end, position + data.size(), color);
+  replaceInLastLine(position, end, data);
+  dropLines();
+}
+
+
+void TextBuffer::truncateLastLine(const std::size_t size)
+{
+  if (mLastLineComplete || size >= mLines.back().size)
+  {
+    return;
+  }
+
+  ++mRevision;
+  auto& line = modifyLastLine(0);
+
+  // A non-empty last line is always at the end of the last chunk
+  const auto removed = line.size - size;
+  mChunks.back().size -= removed;
+  line.size = std::uint32_t(size);
+  mByteCount -= removed;
+
+  while (
+    mFirstSpan + mColorSpans.size() > line.firstSpan &&
+    mColorSpans.back().begin >= size)
+  {
+    mColorSpans.pop_back();
+  }
+}
+
+
+TextBuffer::Line& TextBuffer::modifyLastLine(const std::uint8_t lineFlags)
+{
+  if (mLastLineComplete)
+  {
+    mLines.push_back({nullptr, 0, mRevision, mFirstSpan + mColorSpans.size()});
+    mLineFlags.push_back(0);
+    mLastLineComplete = false;
+  }
+
+  auto& line = mLines.back();
+  line.revision = mRevision;
+  mLineFlags.back() |= lineFlags;
+  return line;
+}
+
+
+char* TextBuffer::reserveForLastLine(const std::size_t size)
+{
+  auto& line = mLines.back();
+
+  // If the last line isn't empty, its text is at the end of the last chunk
+  if (!mChunks.empty())
+  {
+    auto& chunk = mChunks.back();
+    if (chunk.capacity - chunk.size >= size)
+    {
+      const auto pDestination = chunk.pData.get() + chunk.size;
+      if (line.size == 0)
+      {
+        line.pText = pDestination;
+      }
+
+      chunk.size += size;
+      chunk.endLine = endLine();
+      return pDestination;
+    }
+  }
+
+  // Very long lines get a chunk of their own. Growing it in steps of
+  // doubling size avoids copying the line over and over.
+  const auto capacity = std::max(chunkSize, 2 * (line.size + size));
+  auto newChunk = Chunk{
+    std::unique_ptr<char[]>(new char[capacity]),
+    capacity,
+    line.size + size,
+    endLine()};
+
+  if (line.size > 0)
+  {
+    auto& oldChunk = mChunks.back();
+    std::memcpy(newChunk.pData.get(), line.pText, line.size);
+    oldChunk.size -= line.size;
+    oldChunk.endLine = endLine() - 1;
+
+    // If the line was all that was in the old chunk, e.g. because it had
+    // outgrown a chunk of its own before, nothing else needs the chunk
+    if (oldChunk.size == 0)
+    {
+      mChunks.pop_back();
+    }
+  }
+
+  line.pText = newChunk.pData.get();
+  mChunks.push_back(std::move(newChunk));
+  return mChunks.back().pData.get() + line.size;
+}
+
+
+void TextBuffer::replaceInLastLine(
+  const std::size_t begin,
+  const std::size_t end,
+  const std::string_view data)
+{
+  auto& line = mLines.back();
+  const auto oldSize = std::size_t{line.size};
+  const auto removed = end - begin;
+
+  if (data.size() > removed)
+  {
+    reserveForLastLine(data.size() - removed);
+  }
+  else
+  {
+    mChunks.back().size -= removed - data.size();
+  }
+
+  std::memmove(line.pText + begin + data.size(), line.pText + end, oldSize - end);
+  std::memcpy(line.pText + begin, data.data(), data.size());
+  line.size = std::uint32_t(oldSize - removed + data.size());
+  mByteCount = mByteCount - removed + data.size();
+}
+
+
+void TextBuffer::replaceColorInLastLine(
+  const std::size_t begin,
+  const std::size_t end,
+  const std::size_t newEnd,
+  const std::uint32_t color)
+{
+  const auto& line = mLines.back();
+  const auto first = std::size_t(line.firstSpan - mFirstSpan);
+  if (first == mColorSpans.size() && color == defaultColor)
+  {
+    return;
+  }
+
+  // Lines rarely have more than a handful of spans, so we simply build
+  // the last line's list again
+  const auto oldSpans =
+    std::vector<ColorSpan>(mColorSpans.begin() + first, mColorSpans.end());
+  mColorSpans.resize(first);
+
+  auto currentColor = defaultColor;
+  const auto addSpan = [&](const std::size_t position, const std::uint32_t spanColor)
+  {
+    if (mColorSpans.size() > first && mColorSpans.back().begin == position)
+    {
+      mColorSpans.pop_back();
+      currentColor =
+        mColorSpans.size() > first ? mColorSpans.back().color : defaultColor;
+    }
+
+    if (spanColor != currentColor)
+    {
+      mColorSpans.push_back({std::uint32_t(position), spanColor});
+      currentColor = spanColor;
+    }
+  };
+
+  auto colorAfter = defaultColor;
+  for (const auto& span : oldSpans)
+  {
+    if (span.begin < begin)
+    {
+      addSpan(span.begin, span.color);
+    }
+
+    if (span.begin <= end)
+    {
+      colorAfter = span.color;
+    }
+  }
+
+  addSpan(begin, color);
+
+  if (end < line.size)
+  {
+    addSpan(newEnd, colorAfter);
+  }
+
+  for (const auto& span : oldSpans)
+  {
+    if (span.begin > end)
+    {
+      addSpan(span.begin - end + newEnd, span.color);
+    }
+  }
+}
+
+
+void TextBuffer::dropLines()
+{
+  const auto overLimit = [this]()
+  {
+    return
+      (mMaxLines > 0 && mLines.size() > mMaxLines + mRestoredLines) ||
+      (mMaxBytes > 0 && mByteCount > mMaxBytes + mRestoredBytes);
+  };
+
+  while (mLines.size() > 1 && overLimit())
+  {
+    mByteCount -= mLines.front().size;
+    mLines.pop_front();
+    mLineFlags.pop_front();
+    ++mFirstLine;
+  }
+
+  while (!mLines.empty() && mFirstSpan < mLines.front().firstSpan)
+  {
+    mColorSpans.pop_front();
+    ++mFirstSpan;
+  }
+
+  while (!mChunks.empty() && mChunks.front().endLine <= mFirstLine)
+  {
+    mChunks.pop_front();
+  }
+}
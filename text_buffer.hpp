@@ -0,0 +1,224 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <string_view>
+
+
+// Holds the text shown in the viewer, split into lines.
+//
+// Lines are addressed by index. Every line also remembers the revision
+// of the buffer at which it was last modified, so that code caching
+// information derived from lines (layout, vertex data etc.) can find out
+// which lines need to be looked at again.
+//
+// Lines can carry flags, like where they came from. These are kept in a
+// separate array of one byte per line, so that finding all lines with a
+// certain flag doesn't need to touch the text.
+//
+// The amount of text kept can be limited, for scripts which keep
+// producing output for a long time. Once there is more, lines are dropped
+// from the start. Indices are not affected by this, i.e. the first line
+// still there keeps its index, and valid indices are [firstLine(),
+// endLine()). The text is stored in large chunks, which are released as
+// a whole once none of their lines are needed anymore. This keeps
+// dropping lines cheap, and avoids a separate allocation for each line.
+class TextBuffer {
+public:
+  // The line contains output the script wrote to stderr
+  static constexpr auto fromStderrFlag = std::uint8_t{1 << 0};
+
+  // Text from this position (in bytes) up to the next span or the end of
+  // the line is drawn in the given color, which uses the same layout as
+  // IM_COL32(). defaultColor means the line's regular color.
+  struct ColorSpan
+  {
+    std::uint32_t begin;
+    std::uint32_t color;
+  };
+
+  static constexpr auto defaultColor = std::uint32_t{0};
+
+  class ColorSpans {
+  public:
+    using Iterator = std::deque<ColorSpan>::const_iterator;
+
+    ColorSpans(Iterator first, Iterator last)
+      : mFirst(first)
+      , mLast(last)
+    {
+    }
+
+    Iterator begin() const { return mFirst; }
+    Iterator end() const { return mLast; }
+    bool empty() const { return mFirst == mLast; }
+
+  private:
+    Iterator mFirst;
+    Iterator mLast;
+  };
+
+  TextBuffer() = default;
+  explicit TextBuffer(std::string_view text);
+
+  // Sets the maximum number of lines and bytes of text to keep, 0 means
+  // no limit. The last line is always kept, even if it's longer than
+  // maxBytes. Memory use can exceed maxBytes by up to one chunk.
+  void setLimits(std::size_t maxLines, std::size_t maxBytes);
+
+  // Puts the lines [first, end) of another buffer back in front of the
+  // first line, e.g. to restore lines which were dropped due to the
+  // limits. The lines need to be the ones which were dropped, i.e. end
+  // must be firstLine(). Restored lines don't count towards the limits
+  // until the next call to setLimits().
+  void prepend(const TextBuffer& other, std::size_t first, std::size_t end);
+
+  // Replaces the whole text with that of another buffer, e.g. the output
+  // of a script which was run again. Lines which are the same as before
+  // (text, colors and flags) keep their revision, so that information
+  // derived from them stays valid. All others get a new one.
+  void replace(TextBuffer&& other);
+
+  // Appends the given data. Line breaks start a new line, anything after
+  // the last line break goes into a line which further data is appended
+  // to, e.g. when receiving output from a script in pieces. The given
+  // flags are added to all lines which the data goes into, and the text
+  // is drawn in the given color.
+  void append(
+    std::string_view data,
+    std::uint8_t lineFlags = 0,
+    std::uint32_t color = defaultColor);
+
+  // Writes data, which must not contain line breaks, into the last line
+  // starting at the given byte position, replacing as many characters as
+  // it contains. This is how a terminal handles text following a carriage
+  // return. Text going beyond the end of the line is appended, and a gap
+  // between the end of the line and position is filled with blanks.
+  void write(
+    std::size_t position,
+    std::string_view data,
+    std::uint8_t lineFlags,
+    std::uint32_t color);
+
+  // Cuts off the last line after the given number of bytes
+  void truncateLastLine(std::size_t size);
+
+  // False if further data is appended to the last line, true if it goes
+  // into a new line
+  bool lastLineComplete() const { return mLastLineComplete; }
+
+  std::size_t firstLine() const { return mFirstLine; }
+  std::size_t endLine() const { return mFirstLine + mLines.size(); }
+  std::size_t lineCount() const { return mLines.size(); }
+
+  // Size of the text in all lines currently kept
+  std::size_t byteCount() const { return mByteCount; }
+
+  std::string_view line(const std::size_t index) const
+  {
+    const auto& line = mLines[index - mFirstLine];
+    return {line.pText, line.size};
+  }
+
+  std::uint32_t lineRevision(const std::size_t index) const
+  {
+    return mLines[index - mFirstLine].revision;
+  }
+
+  std::uint8_t lineFlags(const std::size_t index) const
+  {
+    return mLineFlags[index - mFirstLine];
+  }
+
+  // Color changes within the given line, ordered by position. Text before
+  // the first span has the default color.
+  ColorSpans colorSpans(const std::size_t index) const
+  {
+    const auto i = index - mFirstLine;
+    const auto first = mLines[i].firstSpan - mFirstSpan;
+    const auto last = i + 1 < mLines.size()
+      ? mLines[i + 1].firstSpan - mFirstSpan
+      : mColorSpans.size();
+    return {mColorSpans.begin() + first, mColorSpans.begin() + last};
+  }
+
+  // Increases with every modification
+  std::uint32_t revision() const { return mRevision; }
+
+  // Revision at which the text was last replaced. Usually, only lines at
+  // the end change, but replacing can change lines anywhere.
+  std::uint32_t replacedRevision() const { return mReplacedRevision; }
+
+private:
+  static constexpr auto chunkSize = std::size_t{64 * 1024};
+
+  // The text of a line is always stored in one piece, within a single
+  // chunk. Empty lines don't point into any chunk. The color spans of all
+  // lines are kept in a single list, each line knows where its own start.
+  struct Line
+  {
+    char* pText;
+    std::uint32_t size;
+    std::uint32_t revision;
+    std::uint64_t firstSpan;
+  };
+
+  struct Chunk
+  {
+    std::unique_ptr<char[]> pData;
+    std::size_t capacity;
+    std::size_t size;
+
+    // Index after the last line stored in this chunk
+    std::size_t endLine;
+  };
+
+  char* reserveForLastLine(std::size_t size);
+  void replaceInLastLine(std::size_t begin, std::size_t end, std::string_view data);
+  void replaceColorInLastLine(
+    std::size_t begin,
+    std::size_t end,
+    std::size_t newEnd,
+    std::uint32_t color);
+  Line& modifyLastLine(std::uint8_t lineFlags);
+  void dropLines();
+
+  std::deque<Chunk> mChunks;
+  std::deque<Line> mLines;
+  std::deque<std::uint8_t> mLineFlags;
+  std::deque<ColorSpan> mColorSpans;
+  std::uint64_t mFirstSpan = 0;
+  std::size_t mFirstLine = 0;
+  std::size_t mByteCount = 0;
+  std::size_t mMaxLines = 0;
+  std::size_t mMaxBytes = 0;
+  std::size_t mRestoredLines = 0;
+  std::size_t mRestoredBytes = 0;
+  std::uint32_t mRevision = 0;
+  std::uint32_t mReplacedRevision = 0;
+  bool mLastLineComplete = true;
+};
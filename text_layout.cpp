@@ -0,0 +1,245 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#include "text_layout.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
+
+float TextLayout::update(
+  const TextBuffer& text,
+  const ImFont* pFont,
+  const float fontSize,
+  const float wrapWidth)
+{
+  auto removedHeight = 0.0f;
+
+  // Start from scratch when the font changed, or when the text was
+  // replaced by one which ends before the first line we know about
+  if (
+    pFont != mpFont ||
+    fontSize != mFontSize ||
+    wrapWidth != mWrapWidth ||
+    text.endLine() < mFirstLine)
+  {
+    mpFont = pFont;
+    mFontSize = fontSize;
+    mWrapWidth = wrapWidth;
+    mMonospaceAdvance = monospaceAdvance(*pFont, fontSize);
+    mFirstLine = text.firstLine();
+    mLines.clear();
+    mRowStarts.assign(1, 0);
+    mMaxWidth = 0.0f;
+    mMaxWidthLines = 0;
+  }
+  else if (
+    text.revision() == mRevision &&
+    text.firstLine() == mFirstLine &&
+    text.endLine() == mFirstLine + mLines.size())
+  {
+    return removedHeight;
+  }
+
+  // Forget about lines which were dropped from the buffer
+  auto removedRows = std::int64_t{0};
+  while (mFirstLine < text.firstLine() && !mLines.empty())
+  {
+    removedRows += mLines.front().rowCount;
+    removeWidth(mLines.front().width);
+    mLines.pop_front();
+    mRowStarts.pop_front();
+    ++mFirstLine;
+  }
+
+  // Lines restored at the start of the buffer go in front of the others
+  if (text.firstLine() < mFirstLine && !mLines.empty())
+  {
+    auto restoredLines = std::vector<LineInfo>{};
+    auto restoredRows = std::uint64_t{0};
+    for (auto i = text.firstLine(); i < mFirstLine; ++i)
+    {
+      restoredLines.push_back(measureLine(text, i));
+      restoredRows += restoredLines.back().rowCount;
+    }
+
+    // Row numbers can't go below 0, so make room if necessary
+    if (mRowStarts.front() < restoredRows)
+    {
+      const auto shift = restoredRows - mRowStarts.front();
+      for (auto& rowStart : mRowStarts)
+      {
+        rowStart += shift;
+      }
+    }
+
+    for (auto i = restoredLines.size(); i > 0; --i)
+    {
+      mLines.push_front(restoredLines[i - 1]);
+      mRowStarts.push_front(mRowStarts.front() - restoredLines[i - 1].rowCount);
+    }
+
+    removedRows -= std::int64_t(restoredRows);
+    mFirstLine = text.firstLine();
+  }
+
+  if (mLines.empty())
+  {
+    mFirstLine = text.firstLine();
+  }
+
+  removedHeight = removedRows * mFontSize;
+
+  // Text is usually only added to the end of the buffer, and only the
+  // last line is modified, so all lines which changed since our last
+  // update are at the end. Walk backwards until we find one we already
+  // know about. If the text was replaced, lines anywhere might have
+  // changed, so we look for the first one that did from the start.
+  const auto knownEnd = std::min(mFirstLine + mLines.size(), text.endLine());
+  auto firstChanged = knownEnd;
+  if (text.replacedRevision() > mRevision)
+  {
+    firstChanged = mFirstLine;
+    while (
+      firstChanged < knownEnd &&
+      text.lineRevision(firstChanged) == mLines[firstChanged - mFirstLine].revision)
+    {
+      ++firstChanged;
+    }
+  }
+  else
+  {
+    while (
+      firstChanged > mFirstLine &&
+      text.lineRevision(firstChanged - 1) != mLines[firstChanged - 1 - mFirstLine].revision)
+    {
+      --firstChanged;
+    }
+  }
+
+  for (auto i = text.endLine() - mFirstLine; i < mLines.size(); ++i)
+  {
+    removeWidth(mLines[i].width);
+  }
+
+  mLines.resize(text.endLine() - mFirstLine);
+  mRowStarts.resize(mLines.size() + 1);
+
+  // Only lines which actually changed are measured again, but the row
+  // numbers of all following ones might need updating
+  for (auto i = firstChanged; i < text.endLine(); ++i)
+  {
+    auto& info = mLines[i - mFirstLine];
+    if (i >= knownEnd || info.revision != text.lineRevision(i))
+    {
+      if (i < knownEnd)
+      {
+        removeWidth(info.width);
+      }
+
+      info = measureLine(text, i);
+    }
+
+    mRowStarts[i - mFirstLine + 1] = mRowStarts[i - mFirstLine] + info.rowCount;
+  }
+
+  if (mMaxWidthLines == 0 && mMaxWidth > 0.0f)
+  {
+    mMaxWidth = 0.0f;
+    for (const auto& info : mLines)
+    {
+      addWidth(info.width);
+    }
+  }
+
+  mRevision = text.revision();
+  return removedHeight;
+}
+
+
+TextLayout::LineInfo TextLayout::measureLine(
+  const TextBuffer& text,
+  const std::size_t index)
+{
+  const auto line = text.line(index);
+  const auto scale = mFontSize / mpFont->FontSize;
+
+  auto info = LineInfo{text.lineRevision(index), 0, 0.0f};
+  if (mWrapWidth > 0.0f)
+  {
+    forEachWrappedRow(*mpFont, scale, line, mWrapWidth, [&](const char*, const char*) {
+      ++info.rowCount;
+    });
+  }
+  else
+  {
+    info.rowCount = 1;
+    info.width = mMonospaceAdvance > 0.0f && isPrintableAscii(line)
+      ? line.size() * mMonospaceAdvance
+      : mpFont->CalcTextSizeA(
+          mFontSize, FLT_MAX, 0.0f, line.data(), line.data() + line.size()).x;
+    addWidth(info.width);
+  }
+
+  return info;
+}
+
+
+void TextLayout::addWidth(const float width)
+{
+  if (width > mMaxWidth)
+  {
+    mMaxWidth = width;
+    mMaxWidthLines = 1;
+  }
+  else if (width == mMaxWidth)
+  {
+    ++mMaxWidthLines;
+  }
+}
+
+
+void TextLayout::removeWidth(const float width)
+{
+  if (width == mMaxWidth && mMaxWidthLines > 0)
+  {
+    --mMaxWidthLines;
+  }
+}
+
+
+std::size_t TextLayout::lineAt(const float y) const
+{
+  const auto row = mRowStarts.front() +
+    static_cast<std::uint64_t>(std::max(y, 0.0f) / mFontSize);
+
+  // Find the last line starting at or before the row
+  const auto iLine = std::upper_bound(mRowStarts.begin(), mRowStarts.end() - 1, row);
+  return mFirstLine +
+    std::max<std::size_t>(std::distance(mRowStarts.begin(), iLine), 1) - 1;
+}
+
+
+ImVec2 TextLayout::contentSize() const
+{
+  return {mMaxWidth, (mRowStarts.back() - mRowStarts.front()) * mFontSize};
+}
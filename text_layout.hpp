@@ -0,0 +1,157 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#pragma once
+
+#include "monospace_grid.hpp"
+#include "text_buffer.hpp"
+
+#include "imgui.h"
+#include "imgui_internal.h"
+
+#include <cstdint>
+#include <deque>
+#include <string_view>
+
+
+// Splits a line of text into the rows it occupies when word-wrapped at the
+// given width, and invokes func(rowBegin, rowEnd) for each of them. A
+// wrapWidth of 0 disables wrapping, producing a single row.
+//
+// This follows the same rules as ImFont::RenderText(), so that the result
+// matches what Dear ImGui would draw.
+template <typename Func>
+void forEachWrappedRow(
+  const ImFont& font,
+  const float scale,
+  const std::string_view line,
+  const float wrapWidth,
+  Func&& func)
+{
+  const auto pEnd = line.data() + line.size();
+  if (wrapWidth <= 0.0f)
+  {
+    func(line.data(), pEnd);
+    return;
+  }
+
+  auto pRowBegin = line.data();
+  do
+  {
+    auto pRowEnd = font.CalcWordWrapPositionA(scale, pRowBegin, pEnd, wrapWidth);
+
+    // If not even a single character fits, display it anyway
+    if (pRowEnd == pRowBegin)
+    {
+      ++pRowEnd;
+    }
+
+    func(pRowBegin, pRowEnd);
+
+    // Wrapping skips upcoming blanks
+    pRowBegin = pRowEnd;
+    while (pRowBegin < pEnd && ImCharIsBlankA(*pRowBegin))
+    {
+      ++pRowBegin;
+    }
+  }
+  while (pRowBegin < pEnd);
+}
+
+
+// Keeps track of the position and size of each line in a TextBuffer, for
+// a given font and wrap width.
+//
+// Measuring text is expensive, so the layout is updated incrementally:
+// Only lines which were modified since the last update are measured
+// again.
+//
+// Positions are relative to the first line still in the buffer. When
+// lines are dropped from the start of the buffer, the remaining ones
+// move up accordingly, and when lines are restored there, they move down.
+class TextLayout {
+public:
+  // Brings the layout up to date. A wrapWidth of 0 disables wrapping.
+  // Changing the font or wrap width requires measuring all lines again.
+  // Returns how far the lines which were there before moved up, due to
+  // lines being dropped from the start of the buffer. It's negative if
+  // they moved down, due to lines being restored at the start.
+  float update(
+    const TextBuffer& text,
+    const ImFont* pFont,
+    float fontSize,
+    float wrapWidth);
+
+  const ImFont* font() const { return mpFont; }
+  float fontSize() const { return mFontSize; }
+  float wrapWidth() const { return mWrapWidth; }
+  float lineHeight() const { return mFontSize; }
+
+  std::size_t lineCount() const { return mLines.size(); }
+
+  // Vertical position of the given line's first row, relative to the
+  // top of the text
+  float lineTop(const std::size_t index) const
+  {
+    return (mRowStarts[index - mFirstLine] - mRowStarts.front()) * mFontSize;
+  }
+
+  // Returns the index of the line at the given vertical position, clamped
+  // to the valid range. Must not be called if there are no lines.
+  std::size_t lineAt(float y) const;
+
+  ImVec2 contentSize() const;
+
+private:
+  struct LineInfo
+  {
+    std::uint32_t revision;
+    std::uint32_t rowCount;
+    float width;
+  };
+
+  LineInfo measureLine(const TextBuffer& text, std::size_t index);
+  void addWidth(float width);
+  void removeWidth(float width);
+
+  const ImFont* mpFont = nullptr;
+  float mFontSize = 0.0f;
+  float mWrapWidth = 0.0f;
+  std::uint32_t mRevision = 0;
+
+  // Advance of all printable ASCII characters if the font is monospaced,
+  // 0 otherwise. Allows measuring lines without looking at each glyph.
+  float mMonospaceAdvance = 0.0f;
+
+  // Information about the lines in the buffer, starting at mFirstLine
+  std::size_t mFirstLine = 0;
+  std::deque<LineInfo> mLines;
+
+  // Index of the first row of each line, plus the total row count at
+  // the end. Counting starts at the very first line ever added, so that
+  // dropping lines at the start doesn't require updating all entries.
+  std::deque<std::uint64_t> mRowStarts{0};
+
+  // Width of the widest line, and how many lines have that width. Once
+  // the last of them is gone, the width is found again from all lines.
+  float mMaxWidth = 0.0f;
+  std::size_t mMaxWidthLines = 0;
+};
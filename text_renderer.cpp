@@ -0,0 +1,1081 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#include "text_renderer.hpp"
+
+#include "hash.hpp"
+#include "shader_program.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+
+namespace
+{
+
+constexpr auto linesPerPage = std::size_t{32};
+
+// Upper bound for the number of pages we keep around. Pages which are not
+// visible anymore are only thrown away once we have more than this.
+constexpr auto maxCachedPages = std::size_t{64};
+
+// Without word wrapping, lines can be arbitrarily long. To keep the
+// amount of vertex data per page bounded, pages only cover a horizontal
+// band of the text. Bands are at least this wide.
+constexpr auto minBandWidth = 512.0f;
+
+// Largest number of vertices addressable by 16-bit indices
+constexpr auto maxVerticesPerSegment = 65536;
+
+// Tiles are RGBA textures
+constexpr auto bytesPerTilePixel = std::size_t{4};
+
+
+const char* vertexShaderSource = R"(
+  #version 100
+  uniform mat4 ProjMtx;
+  uniform vec2 Offset;
+  attribute vec2 Position;
+  attribute vec2 UV;
+  attribute vec4 Color;
+  varying vec2 Frag_UV;
+  varying vec4 Frag_Color;
+
+  void main()
+  {
+    Frag_UV = UV;
+    Frag_Color = Color;
+    gl_Position = ProjMtx * vec4(Position + Offset, 0.0, 1.0);
+  }
+)";
+
+
+const char* fragmentShaderSource = R"(
+  #version 100
+  precision mediump float;
+  uniform sampler2D Texture;
+  varying vec2 Frag_UV;
+  varying vec4 Frag_Color;
+
+  void main()
+  {
+    gl_FragColor = vec4(Frag_Color.rgb, Frag_Color.a * texture2D(Texture, Frag_UV.st).a);
+  }
+)";
+
+
+// Tiles hold the text with premultiplied alpha, since that is what
+// blending the text onto a transparent background produces.
+const char* tileVertexShaderSource = R"(
+  #version 100
+  uniform mat4 ProjMtx;
+  uniform vec2 Offset;
+  uniform vec2 Size;
+  attribute vec2 Position;
+  varying vec2 Frag_UV;
+
+  void main()
+  {
+    Frag_UV = Position;
+    gl_Position = ProjMtx * vec4(Position * Size + Offset, 0.0, 1.0);
+  }
+)";
+
+
+const char* tileFragmentShaderSource = R"(
+  #version 100
+  precision mediump float;
+  uniform sampler2D Texture;
+  varying vec2 Frag_UV;
+
+  void main()
+  {
+    gl_FragColor = texture2D(Texture, Frag_UV.st);
+  }
+)";
+
+
+// Same projection as used by Dear ImGui's renderer. Passing top > bottom
+// flips the vertical axis.
+std::array<float, 16> orthographicProjection(
+  const float L,
+  const float R,
+  const float T,
+  const float B)
+{
+  return {
+    2.0f/(R-L),   0.0f,         0.0f,   0.0f,
+    0.0f,         2.0f/(T-B),   0.0f,   0.0f,
+    0.0f,         0.0f,        -1.0f,   0.0f,
+    (R+L)/(L-R),  (T+B)/(B-T),  0.0f,   1.0f,
+  };
+}
+
+
+// Sets up projection and clipping the same way as Dear ImGui's renderer.
+// Returns false if nothing is visible.
+bool setupClipRect(const ImVec4& clipRect, std::array<float, 16>& projection)
+{
+  const auto& drawData = *ImGui::GetDrawData();
+  const auto fbHeight = drawData.DisplaySize.y * drawData.FramebufferScale.y;
+
+  projection = orthographicProjection(
+    drawData.DisplayPos.x,
+    drawData.DisplayPos.x + drawData.DisplaySize.x,
+    drawData.DisplayPos.y,
+    drawData.DisplayPos.y + drawData.DisplaySize.y);
+
+  const auto clipMin = ImVec2{
+    (clipRect.x - drawData.DisplayPos.x) * drawData.FramebufferScale.x,
+    (clipRect.y - drawData.DisplayPos.y) * drawData.FramebufferScale.y};
+  const auto clipMax = ImVec2{
+    (clipRect.z - drawData.DisplayPos.x) * drawData.FramebufferScale.x,
+    (clipRect.w - drawData.DisplayPos.y) * drawData.FramebufferScale.y};
+  if (clipMax.x <= clipMin.x || clipMax.y <= clipMin.y)
+  {
+    return false;
+  }
+
+  glScissor(
+    (int)clipMin.x,
+    (int)(fbHeight - clipMax.y),
+    (int)(clipMax.x - clipMin.x),
+    (int)(clipMax.y - clipMin.y));
+  return true;
+}
+
+
+// Returns the part of the given text which is (at least partially) within
+// [minX, maxX] when drawn starting at x = 0, and the position at which
+// that part starts.
+std::pair<std::string_view, float> clipHorizontally(
+  const ImFont& font,
+  const float scale,
+  const std::string_view text,
+  const float minX,
+  const float maxX)
+{
+  const auto pEnd = text.data() + text.size();
+
+  auto x = 0.0f;
+  auto pBegin = text.data();
+  auto beginX = 0.0f;
+  for (auto pChar = text.data(); pChar < pEnd; )
+  {
+    unsigned int c = static_cast<unsigned char>(*pChar);
+    const auto length = c < 0x80 ? 1 : ImTextCharFromUtf8(&c, pChar, pEnd);
+
+    const auto advance = font.GetCharAdvance(static_cast<ImWchar>(c)) * scale;
+    if (x + advance < minX)
+    {
+      pBegin = pChar + length;
+      beginX = x + advance;
+    }
+    else if (x > maxX)
+    {
+      return {{pBegin, std::size_t(pChar - pBegin)}, beginX};
+    }
+
+    x += advance;
+    pChar += length;
+  }
+
+  return {{pBegin, std::size_t(pEnd - pBegin)}, beginX};
+}
+
+
+// Returns the range of lines [first, last) making up the given page.
+// The first part of the first page might have been dropped already.
+std::pair<std::size_t, std::size_t> pageLines(
+  const TextBuffer& text,
+  const std::size_t pageIndex)
+{
+  const auto firstLine = std::max(pageIndex * linesPerPage, text.firstLine());
+  const auto lastLine = std::min(
+    pageIndex * linesPerPage + linesPerPage, text.endLine());
+  return {firstLine, std::max(firstLine, lastLine)};
+}
+
+
+// Splits the part [begin, end) of a line into runs of the same color,
+// and invokes func(runBegin, runEnd, color) for each of them. Positions
+// are in bytes, relative to the start of the line.
+template <typename Func>
+void forEachColorRun(
+  const TextBuffer::ColorSpans& spans,
+  std::size_t begin,
+  const std::size_t end,
+  const ImU32 lineColor,
+  Func&& func)
+{
+  const auto spanColor = [&](const TextBuffer::ColorSpan& span)
+  {
+    return span.color == TextBuffer::defaultColor ? lineColor : span.color;
+  };
+
+  auto color = lineColor;
+  auto iSpan = spans.begin();
+  for (; iSpan != spans.end() && iSpan->begin <= begin; ++iSpan)
+  {
+    color = spanColor(*iSpan);
+  }
+
+  while (begin < end)
+  {
+    const auto runEnd = iSpan != spans.end()
+      ? std::min(std::size_t{iSpan->begin}, end)
+      : end;
+    func(begin, runEnd, color);
+    begin = runEnd;
+
+    if (iSpan != spans.end())
+    {
+      color = spanColor(*iSpan);
+      ++iSpan;
+    }
+  }
+}
+
+}
+
+
+bool TextRenderer::Parameters::operator==(const Parameters& other) const
+{
+  return
+    pFont == other.pFont &&
+    fontSize == other.fontSize &&
+    wrapWidth == other.wrapWidth &&
+    bandWidth == other.bandWidth &&
+    color == other.color &&
+    stderrColor == other.stderrColor &&
+    textureId == other.textureId;
+}
+
+
+TextRenderer::TextRenderer(
+  GlyphCache* pGlyphCache,
+  const std::size_t tileCacheBytes)
+  : mpGlyphCache(pGlyphCache)
+  , mTileCacheBytes(tileCacheBytes)
+  , mProgram(createShaderProgram(vertexShaderSource, fragmentShaderSource))
+  , mProjectionLocation(glGetUniformLocation(mProgram, "ProjMtx"))
+  , mOffsetLocation(glGetUniformLocation(mProgram, "Offset"))
+  , mTextureLocation(glGetUniformLocation(mProgram, "Texture"))
+  , mTileProgram(0)
+  , mTileProjectionLocation(-1)
+  , mTileOffsetLocation(-1)
+  , mTileSizeLocation(-1)
+  , mTileTextureLocation(-1)
+  , mTileQuadBuffer(0)
+  , mScratchDrawList(ImGui::GetDrawListSharedData())
+{
+  if (mTileCacheBytes > 0)
+  {
+    mTileProgram =
+      createShaderProgram(tileVertexShaderSource, tileFragmentShaderSource);
+    mTileProjectionLocation = glGetUniformLocation(mTileProgram, "ProjMtx");
+    mTileOffsetLocation = glGetUniformLocation(mTileProgram, "Offset");
+    mTileSizeLocation = glGetUniformLocation(mTileProgram, "Size");
+    mTileTextureLocation = glGetUniformLocation(mTileProgram, "Texture");
+
+    // A unit square, scaled and positioned in the vertex shader
+    const float quad[] = {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f};
+    glGenBuffers(1, &mTileQuadBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mTileQuadBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+  }
+}
+
+
+TextRenderer::~TextRenderer()
+{
+  for (auto& [key, page] : mPages)
+  {
+    releasePage(page);
+  }
+
+  releaseTiles();
+
+  if (mTileCacheBytes > 0)
+  {
+    glDeleteBuffers(1, &mTileQuadBuffer);
+    glDeleteProgram(mTileProgram);
+  }
+
+  glDeleteProgram(mProgram);
+}
+
+
+void TextRenderer::draw(
+  ImDrawList& drawList,
+  const TextBuffer& text,
+  const TextLayout& layout,
+  const ImVec2& origin,
+  const ImVec4& clipRect,
+  const ImU32 color,
+  const ImU32 stderrColor)
+{
+  ++mFrame;
+  mQueuedPages.clear();
+  mQueuedTiles.clear();
+  mTilePages.clear();
+
+  const auto viewWidth = clipRect.z - clipRect.x;
+  const auto parameters = Parameters{
+    layout.font(),
+    layout.fontSize(),
+    layout.wrapWidth(),
+    std::max(viewWidth, minBandWidth),
+    color,
+    stderrColor,
+    layout.font()->ContainerAtlas->TexID};
+  if (!(parameters == mParameters))
+  {
+    for (auto& [key, page] : mPages)
+    {
+      releasePage(page);
+    }
+
+    mPages.clear();
+    releaseTiles();
+    mParameters = parameters;
+    mGrid.setup(*parameters.pFont, parameters.fontSize);
+  }
+
+  auto hash = hashBytes(&clipRect, sizeof(clipRect));
+  if (text.lineCount() > 0)
+  {
+    hash = mTileCacheBytes > 0
+      ? queueTiles(text, layout, origin, clipRect, hash)
+      : queuePages(text, layout, origin, clipRect, hash);
+  }
+
+  mDrawStateHash = hash;
+
+  if (!mQueuedPages.empty() || !mQueuedTiles.empty())
+  {
+    drawList.AddCallback(renderCallback, this);
+    drawList.AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+  }
+
+  evictUnusedPages();
+  evictUnusedTiles();
+}
+
+
+std::uint64_t TextRenderer::queuePages(
+  const TextBuffer& text,
+  const TextLayout& layout,
+  const ImVec2& origin,
+  const ImVec4& clipRect,
+  std::uint64_t hash)
+{
+  const auto subPixelY = origin.y - ImFloor(origin.y);
+
+  // With word wrapping, nothing extends beyond the view horizontally, so
+  // there is only a single band.
+  const auto band = layout.wrapWidth() > 0.0f
+    ? std::size_t{0}
+    : static_cast<std::size_t>(
+        std::max(clipRect.x - origin.x, 0.0f) / mParameters.bandWidth);
+
+  const auto firstPage = layout.lineAt(clipRect.y - origin.y) / linesPerPage;
+  const auto lastPage = layout.lineAt(clipRect.w - origin.y) / linesPerPage;
+
+  for (auto pageIndex = firstPage; pageIndex <= lastPage; ++pageIndex)
+  {
+    const auto& page = preparePage(text, layout, pageIndex, band);
+
+    // Pages are placed on whole pixels, except for the fractional part
+    // of a smooth scrolling offset
+    const auto screenOffset = ImVec2{
+      ImFloor(origin.x + page.origin.x),
+      ImFloor(origin.y + page.origin.y) + subPixelY};
+    mQueuedPages.push_back({&page, screenOffset});
+
+    hash = hashBytes(&page.id, sizeof(page.id), hash);
+    hash = hashBytes(&screenOffset, sizeof(screenOffset), hash);
+  }
+
+  return hash;
+}
+
+
+std::uint64_t TextRenderer::queueTiles(
+  const TextBuffer& text,
+  const TextLayout& layout,
+  const ImVec2& origin,
+  const ImVec4& clipRect,
+  std::uint64_t hash)
+{
+  GLint maxTextureSize = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+
+  const auto tileSize = ImVec2{
+    std::clamp(std::ceil(clipRect.z - clipRect.x), 1.0f, float(maxTextureSize)),
+    std::clamp(std::ceil(clipRect.w - clipRect.y), 1.0f, float(maxTextureSize))};
+  if (tileSize.x != mTileSize.x || tileSize.y != mTileSize.y)
+  {
+    releaseTiles();
+    mTileSize = tileSize;
+  }
+
+  const auto subPixelY = origin.y - ImFloor(origin.y);
+  const auto contentSize = layout.contentSize();
+
+  // Range of tiles covering the visible part of the text
+  const auto minX = std::max(clipRect.x - origin.x, 0.0f);
+  const auto minY = std::max(clipRect.y - origin.y, 0.0f);
+  const auto maxX = std::min(clipRect.z - origin.x, std::max(contentSize.x, 1.0f));
+  const auto maxY = std::min(clipRect.w - origin.y, std::max(contentSize.y, 1.0f));
+  const auto firstColumn = static_cast<std::size_t>(minX / mTileSize.x);
+  const auto firstRow = static_cast<std::size_t>(minY / mTileSize.y);
+  const auto lastColumn = static_cast<std::size_t>(std::max(maxX - 1.0f, minX) / mTileSize.x);
+  const auto lastRow = static_cast<std::size_t>(std::max(maxY - 1.0f, minY) / mTileSize.y);
+
+  for (auto row = firstRow; row <= lastRow; ++row)
+  {
+    for (auto column = firstColumn; column <= lastColumn; ++column)
+    {
+      const auto tileOrigin = ImVec2{column * mTileSize.x, row * mTileSize.y};
+      const auto firstLine = layout.lineAt(tileOrigin.y);
+      const auto lastLine = std::min(
+        layout.lineAt(tileOrigin.y + mTileSize.y) + 1, text.endLine());
+
+      auto& tile = mTiles[(std::uint64_t(row) << 20) | column];
+      tile.lastUsedFrame = mFrame;
+
+      const auto firstTilePage = mTilePages.size();
+      if (
+        !isUpToDate(tile, text, layout, firstLine, lastLine) ||
+        (mpGlyphCache && !mpGlyphCache->touch(tile.dynamicGlyphs)))
+      {
+        if (!tile.texture)
+        {
+          createTile(tile);
+        }
+
+        tile.firstLine = firstLine;
+        tile.lastLine = lastLine;
+        tile.firstLineTop = layout.lineTop(firstLine);
+        tile.revision = text.revision();
+        tile.id = ++mNextTileId;
+        tile.dynamicGlyphs.clear();
+
+        // Bands are at least as wide as a tile, and cover twice their
+        // width. A tile therefore always fits into the band it starts in.
+        const auto band = layout.wrapWidth() > 0.0f
+          ? std::size_t{0}
+          : static_cast<std::size_t>(tileOrigin.x / mParameters.bandWidth);
+
+        for (
+          auto pageIndex = firstLine / linesPerPage;
+          pageIndex <= (lastLine - 1) / linesPerPage;
+          ++pageIndex)
+        {
+          const auto& page = preparePage(text, layout, pageIndex, band);
+          const auto tileOffset = ImVec2{
+            ImFloor(page.origin.x - tileOrigin.x),
+            ImFloor(page.origin.y - tileOrigin.y)};
+          mTilePages.push_back({&page, tileOffset});
+
+          tile.dynamicGlyphs.insert(
+            tile.dynamicGlyphs.end(),
+            page.dynamicGlyphs.begin(),
+            page.dynamicGlyphs.end());
+        }
+
+        std::sort(tile.dynamicGlyphs.begin(), tile.dynamicGlyphs.end());
+        tile.dynamicGlyphs.erase(
+          std::unique(tile.dynamicGlyphs.begin(), tile.dynamicGlyphs.end()),
+          tile.dynamicGlyphs.end());
+      }
+
+      const auto screenOffset = ImVec2{
+        ImFloor(origin.x + tileOrigin.x),
+        ImFloor(origin.y + tileOrigin.y) + subPixelY};
+      mQueuedTiles.push_back(
+        {&tile, screenOffset, firstTilePage, mTilePages.size()});
+
+      hash = hashBytes(&tile.id, sizeof(tile.id), hash);
+      hash = hashBytes(&screenOffset, sizeof(screenOffset), hash);
+    }
+  }
+
+  return hash;
+}
+
+
+TextRenderer::Page& TextRenderer::preparePage(
+  const TextBuffer& text,
+  const TextLayout& layout,
+  const std::size_t pageIndex,
+  const std::size_t band)
+{
+  auto& page = mPages[(std::uint64_t(pageIndex) << 20) | band];
+  if (
+    page.id == 0 ||
+    !isUpToDate(page, text, pageIndex) ||
+    (mpGlyphCache && !mpGlyphCache->touch(page.dynamicGlyphs)))
+  {
+    releasePage(page);
+    buildPage(page, text, layout, pageIndex, band);
+  }
+
+  // Vertex data is relative to the page's first line, so when lines are
+  // dropped from the start of the text, moving the page is all it takes
+  page.origin.y = layout.lineTop(page.firstLine);
+
+  page.lastUsedFrame = mFrame;
+  return page;
+}
+
+
+bool TextRenderer::isUpToDate(
+  const Page& page,
+  const TextBuffer& text,
+  const std::size_t pageIndex) const
+{
+  const auto [firstLine, lastLine] = pageLines(text, pageIndex);
+  if (firstLine != page.firstLine || lastLine - firstLine != page.lineCount)
+  {
+    return false;
+  }
+
+  for (auto i = firstLine; i < lastLine; ++i)
+  {
+    if (text.lineRevision(i) > page.revision)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+bool TextRenderer::isUpToDate(
+  const Tile& tile,
+  const TextBuffer& text,
+  const TextLayout& layout,
+  const std::size_t firstLine,
+  const std::size_t lastLine) const
+{
+  // If lines above the tile change their height (due to word wrapping),
+  // the tile's content moves even though its own lines are unchanged
+  if (
+    tile.id == 0 ||
+    tile.firstLine != firstLine ||
+    tile.lastLine != lastLine ||
+    tile.firstLineTop != layout.lineTop(firstLine))
+  {
+    return false;
+  }
+
+  for (auto i = firstLine; i < lastLine; ++i)
+  {
+    if (text.lineRevision(i) > tile.revision)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+void TextRenderer::buildPage(
+  Page& page,
+  const TextBuffer& text,
+  const TextLayout& layout,
+  const std::size_t pageIndex,
+  const std::size_t band)
+{
+  const auto& font = *mParameters.pFont;
+  const auto scale = mParameters.fontSize / font.FontSize;
+  const auto lineHeight = layout.lineHeight();
+
+  const auto [firstLine, lastLine] = pageLines(text, pageIndex);
+
+  page.firstLine = firstLine;
+  page.lineCount = lastLine - firstLine;
+  page.revision = text.revision();
+  page.origin = {band * mParameters.bandWidth, layout.lineTop(firstLine)};
+  page.id = ++mNextPageId;
+  page.dynamicGlyphs.clear();
+
+  // A band covers its own width plus one view width, so that the whole
+  // view is always covered by a single band.
+  const auto bandEnd = mParameters.bandWidth * 2.0f;
+  const auto clipRect = ImVec4{0.0f, -FLT_MAX, bandEnd, FLT_MAX};
+
+  mScratchDrawList._ResetForNewFrame();
+  mScratchDrawList.PushTextureID(mParameters.textureId);
+
+  for (auto i = firstLine; i < lastLine; ++i)
+  {
+    auto rowY = layout.lineTop(i) - page.origin.y;
+    const auto line = text.line(i);
+    const auto colorSpans = text.colorSpans(i);
+    const auto color = (text.lineFlags(i) & TextBuffer::fromStderrFlag)
+      ? mParameters.stderrColor
+      : mParameters.color;
+
+    forEachWrappedRow(
+      font,
+      scale,
+      line,
+      mParameters.wrapWidth,
+      [&](const char* pRowBegin, const char* pRowEnd)
+      {
+        auto row = std::string_view{pRowBegin, std::size_t(pRowEnd - pRowBegin)};
+
+        // Most log lines are plain ASCII, and usually shown in a monospaced
+        // font. Those don't need to go through RenderText().
+        if (mGrid.isEnabled() && isPrintableAscii(row))
+        {
+          auto rowX = 0.0f;
+          if (mParameters.wrapWidth <= 0.0f)
+          {
+            const auto [first, last] = mGrid.visibleColumns(
+              row.size(), page.origin.x, page.origin.x + bandEnd);
+            row = row.substr(first, last - first);
+            rowX = first * mGrid.advance() - page.origin.x;
+          }
+
+          if (mScratchDrawList.VtxBuffer.Size + int(row.size()) * 4 > maxVerticesPerSegment)
+          {
+            uploadSegment(page);
+          }
+
+          const auto rowBegin = std::size_t(row.data() - line.data());
+          forEachColorRun(
+            colorSpans,
+            rowBegin,
+            rowBegin + row.size(),
+            color,
+            [&](const std::size_t runBegin, const std::size_t runEnd, const ImU32 runColor)
+            {
+              mGrid.addRow(
+                mScratchDrawList,
+                line.substr(runBegin, runEnd - runBegin),
+                {rowX + (runBegin - rowBegin) * mGrid.advance(), rowY},
+                runColor);
+            });
+          rowY += lineHeight;
+          return;
+        }
+
+        auto rowX = 0.0f;
+        if (mParameters.wrapWidth <= 0.0f)
+        {
+          std::tie(row, rowX) = clipHorizontally(
+            font, scale, row, page.origin.x, page.origin.x + bandEnd);
+          rowX -= page.origin.x;
+        }
+
+        if (mpGlyphCache)
+        {
+          mpGlyphCache->makeResident(row, &page.dynamicGlyphs);
+        }
+
+        const auto maxVertices = int(row.size()) * 4;
+        if (mScratchDrawList.VtxBuffer.Size + maxVertices > maxVerticesPerSegment)
+        {
+          uploadSegment(page);
+        }
+
+        const auto rowBegin = std::size_t(row.data() - line.data());
+        forEachColorRun(
+          colorSpans,
+          rowBegin,
+          rowBegin + row.size(),
+          color,
+          [&](const std::size_t runBegin, const std::size_t runEnd, const ImU32 runColor)
+          {
+            const auto pRunBegin = line.data() + runBegin;
+            const auto pRunEnd = line.data() + runEnd;
+            font.RenderText(
+              &mScratchDrawList,
+              mParameters.fontSize,
+              {rowX, rowY},
+              runColor,
+              clipRect,
+              pRunBegin,
+              pRunEnd);
+
+            if (runEnd < rowBegin + row.size())
+            {
+              rowX += font.CalcTextSizeA(
+                mParameters.fontSize, FLT_MAX, 0.0f, pRunBegin, pRunEnd).x;
+            }
+          });
+        rowY += lineHeight;
+      });
+  }
+
+  uploadSegment(page);
+  ++stats().textPagesBuilt;
+
+  std::sort(page.dynamicGlyphs.begin(), page.dynamicGlyphs.end());
+  page.dynamicGlyphs.erase(
+    std::unique(page.dynamicGlyphs.begin(), page.dynamicGlyphs.end()),
+    page.dynamicGlyphs.end());
+}
+
+
+void TextRenderer::uploadSegment(Page& page)
+{
+  if (mScratchDrawList.IdxBuffer.Size > 0)
+  {
+    Segment segment;
+    glGenBuffers(1, &segment.vertexBuffer);
+    glGenBuffers(1, &segment.indexBuffer);
+    segment.indexCount = mScratchDrawList.IdxBuffer.Size;
+
+    glBindBuffer(GL_ARRAY_BUFFER, segment.vertexBuffer);
+    glBufferData(
+      GL_ARRAY_BUFFER,
+      mScratchDrawList.VtxBuffer.size_in_bytes(),
+      mScratchDrawList.VtxBuffer.Data,
+      GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, segment.indexBuffer);
+    glBufferData(
+      GL_ELEMENT_ARRAY_BUFFER,
+      mScratchDrawList.IdxBuffer.size_in_bytes(),
+      mScratchDrawList.IdxBuffer.Data,
+      GL_STATIC_DRAW);
+
+    page.segments.push_back(segment);
+  }
+
+  mScratchDrawList._ResetForNewFrame();
+  mScratchDrawList.PushTextureID(mParameters.textureId);
+}
+
+
+void TextRenderer::releasePage(Page& page)
+{
+  for (const auto& segment : page.segments)
+  {
+    glDeleteBuffers(1, &segment.vertexBuffer);
+    glDeleteBuffers(1, &segment.indexBuffer);
+  }
+
+  page.segments.clear();
+}
+
+
+void TextRenderer::evictUnusedPages()
+{
+  if (mPages.size() <= maxCachedPages)
+  {
+    return;
+  }
+
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> candidates;
+  for (const auto& [key, page] : mPages)
+  {
+    if (page.lastUsedFrame != mFrame)
+    {
+      candidates.emplace_back(page.lastUsedFrame, key);
+    }
+  }
+
+  std::sort(candidates.begin(), candidates.end());
+
+  for (const auto& [lastUsedFrame, key] : candidates)
+  {
+    if (mPages.size() <= maxCachedPages)
+    {
+      break;
+    }
+
+    auto iPage = mPages.find(key);
+    releasePage(iPage->second);
+    mPages.erase(iPage);
+  }
+}
+
+
+void TextRenderer::createTile(Tile& tile)
+{
+  glGenTextures(1, &tile.texture);
+  glBindTexture(GL_TEXTURE_2D, tile.texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(
+    GL_TEXTURE_2D,
+    0,
+    GL_RGBA,
+    GLsizei(mTileSize.x),
+    GLsizei(mTileSize.y),
+    0,
+    GL_RGBA,
+    GL_UNSIGNED_BYTE,
+    nullptr);
+
+  GLint previousFramebuffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+  glGenFramebuffers(1, &tile.framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, tile.framebuffer);
+  glFramebufferTexture2D(
+    GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tile.texture, 0);
+  const auto status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+  if (status != GL_FRAMEBUFFER_COMPLETE)
+  {
+    releaseTile(tile);
+    throw std::runtime_error("Failed to create framebuffer for text tile");
+  }
+}
+
+
+void TextRenderer::releaseTile(Tile& tile)
+{
+  if (tile.framebuffer)
+  {
+    glDeleteFramebuffers(1, &tile.framebuffer);
+  }
+
+  if (tile.texture)
+  {
+    glDeleteTextures(1, &tile.texture);
+  }
+
+  tile = Tile{};
+}
+
+
+void TextRenderer::releaseTiles()
+{
+  for (auto& [key, tile] : mTiles)
+  {
+    releaseTile(tile);
+  }
+
+  mTiles.clear();
+}
+
+
+void TextRenderer::evictUnusedTiles()
+{
+  const auto tileBytes =
+    std::size_t(mTileSize.x) * std::size_t(mTileSize.y) * bytesPerTilePixel;
+  if (mTiles.size() * tileBytes <= mTileCacheBytes)
+  {
+    return;
+  }
+
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> candidates;
+  for (const auto& [key, tile] : mTiles)
+  {
+    if (tile.lastUsedFrame != mFrame)
+    {
+      candidates.emplace_back(tile.lastUsedFrame, key);
+    }
+  }
+
+  std::sort(candidates.begin(), candidates.end());
+
+  for (const auto& [lastUsedFrame, key] : candidates)
+  {
+    if (mTiles.size() * tileBytes <= mTileCacheBytes)
+    {
+      break;
+    }
+
+    auto iTile = mTiles.find(key);
+    releaseTile(iTile->second);
+    mTiles.erase(iTile);
+  }
+}
+
+
+void TextRenderer::renderCallback(const ImDrawList*, const ImDrawCmd* pCmd)
+{
+  auto& self = *static_cast<TextRenderer*>(pCmd->UserCallbackData);
+  if (self.mTileCacheBytes > 0)
+  {
+    self.renderQueuedTiles(pCmd->ClipRect);
+  }
+  else
+  {
+    self.renderQueuedPages(pCmd->ClipRect);
+  }
+}
+
+
+void TextRenderer::renderQueuedPages(const ImVec4& clipRect)
+{
+  auto projection = std::array<float, 16>{};
+  if (!setupClipRect(clipRect, projection))
+  {
+    return;
+  }
+
+  drawPages(
+    mQueuedPages.data(),
+    mQueuedPages.data() + mQueuedPages.size(),
+    projection.data());
+}
+
+
+void TextRenderer::renderQueuedTiles(const ImVec4& clipRect)
+{
+  // Tiles need to be rendered before setting up for drawing them, since
+  // that changes the viewport etc.
+  for (const auto& queuedTile : mQueuedTiles)
+  {
+    if (queuedTile.firstPage != queuedTile.endPage)
+    {
+      renderTile(queuedTile);
+    }
+  }
+
+  auto projection = std::array<float, 16>{};
+  if (!setupClipRect(clipRect, projection))
+  {
+    return;
+  }
+
+  glUseProgram(mTileProgram);
+  glUniformMatrix4fv(mTileProjectionLocation, 1, GL_FALSE, projection.data());
+  glUniform1i(mTileTextureLocation, 0);
+  glUniform2f(mTileSizeLocation, mTileSize.x, mTileSize.y);
+
+  GLint maxAttributes = 0;
+  glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &maxAttributes);
+  for (auto i = 0; i < maxAttributes; ++i)
+  {
+    glDisableVertexAttribArray(i);
+  }
+
+  glEnableVertexAttribArray(positionAttribute);
+  glBindBuffer(GL_ARRAY_BUFFER, mTileQuadBuffer);
+  glVertexAttribPointer(positionAttribute, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+  // The tiles' content is already blended, with premultiplied alpha
+  glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+  for (const auto& queuedTile : mQueuedTiles)
+  {
+    glBindTexture(GL_TEXTURE_2D, queuedTile.pTile->texture);
+    glUniform2f(
+      mTileOffsetLocation, queuedTile.screenOffset.x, queuedTile.screenOffset.y);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  }
+}
+
+
+void TextRenderer::renderTile(const QueuedTile& queuedTile)
+{
+  GLint previousFramebuffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, queuedTile.pTile->framebuffer);
+  glViewport(0, 0, GLsizei(mTileSize.x), GLsizei(mTileSize.y));
+  glDisable(GL_SCISSOR_TEST);
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  // Blending onto a transparent background this way leaves us with
+  // premultiplied alpha
+  glBlendFuncSeparate(
+    GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+  // The top of the tile ends up in the first row of the texture
+  const auto projection =
+    orthographicProjection(0.0f, mTileSize.x, mTileSize.y, 0.0f);
+  drawPages(
+    mTilePages.data() + queuedTile.firstPage,
+    mTilePages.data() + queuedTile.endPage,
+    projection.data());
+
+  glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+  glEnable(GL_SCISSOR_TEST);
+
+  // Restore the viewport set up by Dear ImGui's renderer
+  const auto& drawData = *ImGui::GetDrawData();
+  glViewport(
+    0,
+    0,
+    GLsizei(drawData.DisplaySize.x * drawData.FramebufferScale.x),
+    GLsizei(drawData.DisplaySize.y * drawData.FramebufferScale.y));
+
+  ++stats().textTilesRendered;
+}
+
+
+void TextRenderer::drawPages(
+  const QueuedPage* pBegin,
+  const QueuedPage* pEnd,
+  const float* pProjection)
+{
+  glUseProgram(mProgram);
+  glUniformMatrix4fv(mProjectionLocation, 1, GL_FALSE, pProjection);
+  glUniform1i(mTextureLocation, 0);
+  glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)mParameters.textureId);
+
+  // The attributes enabled by Dear ImGui's renderer might be different
+  // from ours. They will be restored by the ResetRenderState callback
+  // following ours.
+  GLint maxAttributes = 0;
+  glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &maxAttributes);
+  for (auto i = 0; i < maxAttributes; ++i)
+  {
+    glDisableVertexAttribArray(i);
+  }
+
+  glEnableVertexAttribArray(positionAttribute);
+  glEnableVertexAttribArray(uvAttribute);
+  glEnableVertexAttribArray(colorAttribute);
+
+  for (auto pQueuedPage = pBegin; pQueuedPage != pEnd; ++pQueuedPage)
+  {
+    glUniform2f(
+      mOffsetLocation, pQueuedPage->screenOffset.x, pQueuedPage->screenOffset.y);
+
+    for (const auto& segment : pQueuedPage->pPage->segments)
+    {
+      glBindBuffer(GL_ARRAY_BUFFER, segment.vertexBuffer);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, segment.indexBuffer);
+      glVertexAttribPointer(positionAttribute, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, pos));
+      glVertexAttribPointer(uvAttribute, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, uv));
+      glVertexAttribPointer(colorAttribute, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, col));
+      glDrawElements(
+        GL_TRIANGLES,
+        segment.indexCount,
+        sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+        nullptr);
+    }
+  }
+}
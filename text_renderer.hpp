@@ -0,0 +1,257 @@
+/** Copyright (c) 2021 Nikolai Wuttke
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in all
+  * copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#pragma once
+
+#include "glyph_cache.hpp"
+#include "monospace_grid.hpp"
+#include "text_buffer.hpp"
+#include "text_layout.hpp"
+
+#include "imgui.h"
+
+#include <GLES2/gl2.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+
+// Renders the text body using retained vertex data.
+//
+// Regular Dear ImGui text rendering generates vertices for every visible
+// glyph on every frame. Instead, we generate vertex data once for a page
+// of lines at a time, store it in GPU buffers, and keep reusing it for as
+// long as the page is visible and unchanged. The vertex data is relative
+// to the page, and positioned on screen via a shader uniform, so
+// scrolling only changes a translation. New vertex data is only created
+// for pages coming into view.
+//
+// On weak GPUs, drawing thousands of glyph quads each frame can still be
+// too slow. Optionally, the pages can therefore be rendered into view
+// sized tiles (textures) once, so that each frame only needs to draw a
+// few textured rectangles. Tiles are kept around within a GPU memory
+// budget, throwing away the least recently used ones first.
+//
+// Drawing happens via a draw list callback, so that the text ends up at
+// the right place in relation to the rest of the UI.
+class TextRenderer {
+public:
+  // pGlyphCache is optional. If given, glyphs from it are made resident
+  // before building vertex data which uses them.
+  // If tileCacheBytes is not 0, text is drawn via cached tiles using at
+  // most that much texture memory (more if the visible tiles alone need
+  // more than that).
+  explicit TextRenderer(
+    GlyphCache* pGlyphCache = nullptr,
+    std::size_t tileCacheBytes = 0);
+  ~TextRenderer();
+
+  TextRenderer(const TextRenderer&) = delete;
+  TextRenderer& operator=(const TextRenderer&) = delete;
+
+  // Draws the part of the text which is visible within clipRect. origin
+  // is the screen position of the top-left corner of the text, i.e. it
+  // takes scrolling into account. Its vertical part doesn't need to be a
+  // whole number, which allows for smooth scrolling. Scrolling only
+  // changes a shader uniform, vertex data is only built for pages
+  // coming into view. Lines holding output from stderr are drawn in
+  // stderrColor.
+  void draw(
+    ImDrawList& drawList,
+    const TextBuffer& text,
+    const TextLayout& layout,
+    const ImVec2& origin,
+    const ImVec4& clipRect,
+    ImU32 color,
+    ImU32 stderrColor);
+
+  // The draw list only contains a callback for the text, so it doesn't
+  // change when the text does. This hash covers everything drawn by the
+  // last call to draw(), and needs to be taken into account when
+  // checking if a frame looks any different from the previous one.
+  std::uint64_t drawStateHash() const { return mDrawStateHash; }
+
+private:
+  // Everything which affects the generated vertex data of all pages.
+  // If any of this changes, all cached pages are thrown away.
+  struct Parameters
+  {
+    const ImFont* pFont = nullptr;
+    float fontSize = 0.0f;
+    float wrapWidth = 0.0f;
+    float bandWidth = 0.0f;
+    ImU32 color = 0;
+    ImU32 stderrColor = 0;
+    ImTextureID textureId = nullptr;
+
+    bool operator==(const Parameters& other) const;
+  };
+
+  // Vertex data in GPU buffers. Indices are 16 bit, so a page might need
+  // several of these.
+  struct Segment
+  {
+    GLuint vertexBuffer;
+    GLuint indexBuffer;
+    GLsizei indexCount;
+  };
+
+  struct Page
+  {
+    std::vector<Segment> segments;
+
+    // State of the text when this page was built, to detect changes
+    std::size_t firstLine = 0;
+    std::size_t lineCount = 0;
+    std::uint32_t revision = 0;
+
+    // Glyphs from the glyph cache used by this page
+    std::vector<GlyphCache::UsedGlyph> dynamicGlyphs;
+
+    // Document space position which the vertices are relative to
+    ImVec2 origin;
+
+    // Unique for every page we build, even when rebuilding the same one.
+    // 0 means the page hasn't been built yet.
+    std::uint64_t id = 0;
+    std::uint64_t lastUsedFrame = 0;
+  };
+
+  struct QueuedPage
+  {
+    const Page* pPage;
+    ImVec2 screenOffset;
+  };
+
+  // A view sized area of the text, rendered into a texture
+  struct Tile
+  {
+    GLuint texture = 0;
+    GLuint framebuffer = 0;
+
+    // State of the text when this tile was rendered, to detect changes
+    std::size_t firstLine = 0;
+    std::size_t lastLine = 0;
+    float firstLineTop = 0.0f;
+    std::uint32_t revision = 0;
+
+    // Glyphs from the glyph cache used by the pages rendered into the
+    // tile
+    std::vector<GlyphCache::UsedGlyph> dynamicGlyphs;
+
+    // Unique for every tile we render, even when re-rendering the same one
+    std::uint64_t id = 0;
+    std::uint64_t lastUsedFrame = 0;
+  };
+
+  struct QueuedTile
+  {
+    Tile* pTile;
+    ImVec2 screenOffset;
+
+    // Pages to render into the tile before drawing it, as a range in
+    // mTilePages. Empty if the tile is up to date.
+    std::size_t firstPage;
+    std::size_t endPage;
+  };
+
+  std::uint64_t queuePages(
+    const TextBuffer& text,
+    const TextLayout& layout,
+    const ImVec2& origin,
+    const ImVec4& clipRect,
+    std::uint64_t hash);
+  std::uint64_t queueTiles(
+    const TextBuffer& text,
+    const TextLayout& layout,
+    const ImVec2& origin,
+    const ImVec4& clipRect,
+    std::uint64_t hash);
+  Page& preparePage(
+    const TextBuffer& text,
+    const TextLayout& layout,
+    std::size_t pageIndex,
+    std::size_t band);
+
+  bool isUpToDate(const Page& page, const TextBuffer& text, std::size_t pageIndex) const;
+  bool isUpToDate(
+    const Tile& tile,
+    const TextBuffer& text,
+    const TextLayout& layout,
+    std::size_t firstLine,
+    std::size_t lastLine) const;
+  void buildPage(
+    Page& page,
+    const TextBuffer& text,
+    const TextLayout& layout,
+    std::size_t pageIndex,
+    std::size_t band);
+  void uploadSegment(Page& page);
+  void releasePage(Page& page);
+  void evictUnusedPages();
+  void createTile(Tile& tile);
+  void releaseTile(Tile& tile);
+  void releaseTiles();
+  void evictUnusedTiles();
+
+  static void renderCallback(const ImDrawList* pDrawList, const ImDrawCmd* pCmd);
+  void renderQueuedPages(const ImVec4& clipRect);
+  void renderQueuedTiles(const ImVec4& clipRect);
+  void renderTile(const QueuedTile& queuedTile);
+  void drawPages(
+    const QueuedPage* pBegin,
+    const QueuedPage* pEnd,
+    const float* pProjection);
+
+  GlyphCache* mpGlyphCache;
+  std::size_t mTileCacheBytes;
+
+  GLuint mProgram;
+  GLint mProjectionLocation;
+  GLint mOffsetLocation;
+  GLint mTextureLocation;
+
+  GLuint mTileProgram;
+  GLint mTileProjectionLocation;
+  GLint mTileOffsetLocation;
+  GLint mTileSizeLocation;
+  GLint mTileTextureLocation;
+  GLuint mTileQuadBuffer;
+
+  Parameters mParameters;
+  std::unordered_map<std::uint64_t, Page> mPages;
+  std::vector<QueuedPage> mQueuedPages;
+
+  // Tiles are all the same size, covering the view
+  ImVec2 mTileSize;
+  std::unordered_map<std::uint64_t, Tile> mTiles;
+  std::vector<QueuedTile> mQueuedTiles;
+  std::vector<QueuedPage> mTilePages;
+  ImDrawList mScratchDrawList;
+  MonospaceGrid mGrid;
+
+  std::uint64_t mNextPageId = 0;
+  std::uint64_t mNextTileId = 0;
+  std::uint64_t mFrame = 0;
+  std::uint64_t mDrawStateHash = 0;
+};
@@ -21,87 +21,157 @@
 
 #include "view.hpp"
 
+#include "glyph_cache.hpp"
+#include "line_timestamps.hpp"
+#include "log_index.hpp"
+#include "script_reader.hpp"
+#include "stats.hpp"
+#include "text_renderer.hpp"
+
 #include "imgui_internal.h"
 
-#include <poll.h>
-#include <unistd.h>
+#include <SDL.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+
+namespace
+{
+
+// Color for lines containing output the script wrote to stderr. Readable
+// on the regular background as well as the red one used for errors.
+constexpr auto stderrTextColor = IM_COL32(255, 170, 90, 255);
+
+// How many lines dropped due to the scrollback limit are loaded from the
+// log file at once when scrolling back to them
+constexpr auto linesRestoredAtOnce = std::size_t{1000};
+
+// When running a script repeatedly, lines which changed compared to the
+// previous run are highlighted for this long
+constexpr auto changeHighlightDuration = std::chrono::seconds{1};
+
+
+// Timer callback which pushes an event of the type given as parameter, to
+// wake up the main loop. The type is passed by value, so that a timer
+// still pending when the view goes away doesn't refer to anything gone.
+Uint32 pushWakeupEvent(Uint32, void* pParam)
+{
+  SDL_Event event{};
+  event.type = Uint32(reinterpret_cast<std::uintptr_t>(pParam));
+  SDL_PushEvent(&event);
+  return 0;
+}
 
-#include <sstream>
-#include <stdexcept>
+}
 
 
 View::View(
+  TextRenderer& textRenderer,
+  GlyphCache* pGlyphCache,
   std::string windowTitle,
   std::string inputTextOrScriptFile,
   const bool showYesNoButtons,
   const bool wrapLines,
-  const bool inputTextIsScriptFile)
-  : mTitle(std::move(windowTitle))
-  , mText([&]() -> decltype(mText) {
-      // When executing a script, mText is gradually filled up
-      // with the script's output. We need to initialize it
-      // to either an empty string, or an empty list of lines
-      // depending on if word wrapping is enabled or not.
-      if (inputTextIsScriptFile)
-      {
-        if (wrapLines)
-        {
-          return std::vector<std::string>{};
-        }
-        else
-        {
-          return "";
-        }
-      }
-
-      return std::move(inputTextOrScriptFile);
-    }())
-  , mpScriptPipe(nullptr)
-  , mScriptPipeFd(-1)
+  const bool inputTextIsScriptFile,
+  const bool runScriptViaShell,
+  const bool runScriptInPseudoterminal,
+  const std::string& logFile,
+  const bool showLineTimestamps,
+  const Clock::duration rerunInterval,
+  const std::uint32_t scriptOutputEventType,
+  const std::size_t maxLines,
+  const std::size_t maxBytes)
+  : mTextRenderer(textRenderer)
+  , mpGlyphCache(pGlyphCache)
+  , mTitle(std::move(windowTitle))
+  , mOutputParser(mText, 0)
+  , mErrorOutputParser(mText, TextBuffer::fromStderrFlag)
+  , mGlyphsRegisteredRevision(0)
+  , mpTextWindow(nullptr)
+  , mSmoothScrollY(0.0f)
+  , mScriptReadTime(Clock::duration::zero())
+  , mWakeupEventType(scriptOutputEventType)
+  , mMaxLines(maxLines)
+  , mMaxBytes(maxBytes)
+  , mLinesRestored(false)
+  , mRerunInterval(rerunInterval)
+  , mChangedLinesRevision(0)
   , mShowYesNoButtons(showYesNoButtons)
+  , mWrapLines(wrapLines)
 {
+  mText.setLimits(maxLines, maxBytes);
+
   // We are executing a script instead of showing some text.
-  // Start executing it, and grab the file descriptor for polling.
+  // Its output is read on a background thread, and the text buffer is
+  // gradually filled up with it.
   if (inputTextIsScriptFile)
   {
-    mpScriptPipe = popen((inputTextOrScriptFile + " 2>&1 ").c_str(), "r");
-    if (!mpScriptPipe)
+    mpScriptReader = std::make_unique<ScriptReader>(
+      inputTextOrScriptFile,
+      runScriptViaShell,
+      runScriptInPseudoterminal,
+      logFile,
+      scriptOutputEventType);
+
+    if (!logFile.empty())
     {
-      throw std::runtime_error("Failed to execute script");
+      mpLogIndex = std::make_unique<LogIndex>(logFile);
     }
 
-    mScriptPipeFd = fileno(mpScriptPipe);
-    if (mScriptPipeFd == -1)
+    if (showLineTimestamps)
     {
-      pclose(mpScriptPipe);
-      throw std::runtime_error("Failed to execute script");
+      mpLineTimestamps = std::make_unique<LineTimestamps>();
     }
-  }
-  else if (wrapLines)
-  {
-    std::stringstream stream{std::get<std::string>(mText)};
-    std::vector<std::string> lines;
-    for (std::string line; std::getline(stream, line); )
+
+    // For running the script again, see startNextRun()
+    if (rerunInterval > Clock::duration::zero())
     {
-      lines.push_back(line);
+      mStartScript = [=]()
+      {
+        return std::make_unique<ScriptReader>(
+          inputTextOrScriptFile,
+          runScriptViaShell,
+          runScriptInPseudoterminal,
+          std::string{},
+          scriptOutputEventType);
+      };
     }
+  }
+  else
+  {
+    mText.append(inputTextOrScriptFile);
+  }
 
-    mText = std::move(lines);
+  if (mpGlyphCache)
+  {
+    mpGlyphCache->registerText(mTitle);
+    registerNewGlyphs();
   }
 }
 
 
-View::~View()
-{
-  closeScriptPipe();
-}
+View::~View() = default;
 
 
-std::optional<int> View::draw(const ImVec2& windowSize)
+std::optional<int> View::draw(
+  const ImVec2& windowSize,
+  const Clock::duration scriptReadBudget)
 {
+  mScriptReadTime = Clock::duration::zero();
+
   ImGui::SetNextWindowSize(windowSize);
   ImGui::SetNextWindowPos(ImVec2(0, 0));
 
+  if (mpGlyphCache)
+  {
+    mpGlyphCache->beginFrame();
+    mpGlyphCache->makeResident(mTitle);
+  }
+
   bool scroll = false;
   auto running = true;
   ImGui::Begin(
@@ -134,38 +204,105 @@ std::optional<int> View::draw(const ImVec2& windowSize)
   }
 
   // Draw the scrollable region containing the text
+  const auto subPixelScrollY = updateSmoothScrolling();
   ImGui::BeginChild(
     "#scroll_area",
     {0, maxTextHeight},
     true,
     ImGuiWindowFlags_HorizontalScrollbar);
+  mpTextWindow = ImGui::GetCurrentWindow();
+
+  // New output only scrolls the text if we were already showing the end
+  // of it. Once the user scrolls up to read something, the text stays
+  // where it is, until they scroll back down to the bottom. This has to
+  // be checked before the new output changes the content size.
+  const auto atBottom =
+    mpTextWindow->Scroll.y >= mpTextWindow->ScrollMax.y - 1.0f;
+
+  if (mNextRunTime && Clock::now() >= *mNextRunTime)
+  {
+    startNextRun();
+  }
 
   // We are executing a script instead of showing some text.
   // Fetch output from the script and append it to our text buffer.
-  if (mpScriptPipe)
+  if (mpScriptReader)
   {
-    scroll = fetchScriptOutput();
+    scroll = fetchScriptOutput(scriptReadBudget) && atBottom;
   }
 
-  // Draw the text buffer.
-  if (const auto pText = std::get_if<std::string>(&mText))
+  if (mpLogIndex)
   {
-    ImGui::TextUnformatted(pText->c_str());
+    restoreDroppedLines();
   }
-  else if (const auto pLines = std::get_if<std::vector<std::string>>(&mText))
+
+  // Glyph metrics need to be known before measuring the text
+  registerNewGlyphs();
+
+  // Draw the text buffer. The text itself is drawn by the TextRenderer,
+  // we only need to tell Dear ImGui how much space it takes up so that
+  // scrolling works.
+  const auto gutterWidth = lineTimestampsWidth();
+  const auto wrapWidth = mWrapLines
+    ? std::max(ImGui::GetContentRegionAvail().x - gutterWidth, 1.0f)
+    : 0.0f;
+  const auto removedHeight =
+    mLayout.update(mText, ImGui::GetFont(), ImGui::GetFontSize(), wrapWidth);
+
+  // If old lines were dropped from the text due to the scrollback limit,
+  // the remaining ones moved up (or down, if lines were restored). We
+  // scroll by the same amount, so that the visible text stays in place.
+  // Dear ImGui has already positioned this frame's content using the
+  // previous scroll position, so this frame's text origin needs to be
+  // adjusted as well.
+  const auto scrollShift = std::min(removedHeight, mpTextWindow->Scroll.y);
+  auto textOrigin = ImGui::GetCursorScreenPos();
+  textOrigin.y += scrollShift - subPixelScrollY;
+
+  // The timestamps stay in place when scrolling horizontally, the text
+  // scrolls underneath them
+  auto textClipRect = mpTextWindow->ClipRect;
+  if (mpLineTimestamps)
   {
-    for (const auto& line : *pLines)
-    {
-      ImGui::TextWrapped(line.c_str());
-    }
+    const auto gutterLeft = textOrigin.x + mpTextWindow->Scroll.x;
+    drawLineTimestamps({gutterLeft, textOrigin.y}, gutterWidth);
+
+    textOrigin.x += gutterWidth;
+    textClipRect.Min.x = std::max(textClipRect.Min.x, gutterLeft + gutterWidth);
   }
 
+  if (Clock::now() < mHighlightEndTime)
+  {
+    drawChangeHighlights(textOrigin);
+  }
+
+  ImGui::PushClipRect(textClipRect.Min, textClipRect.Max, true);
+  mTextRenderer.draw(
+    *ImGui::GetWindowDrawList(),
+    mText,
+    mLayout,
+    textOrigin,
+    textClipRect.ToVec4(),
+    ImGui::GetColorU32(ImGuiCol_Text),
+    stderrTextColor);
+  ImGui::PopClipRect();
+  const auto contentSize = mLayout.contentSize();
+  ImGui::Dummy({contentSize.x + gutterWidth, contentSize.y});
+
   // Handle scrolling automatically as we receive output from the script
   if (scroll)
   {
     ImGui::SetScrollHereY(1.0);
   }
 
+  // This needs to happen after SetScrollHereY(), which works relative to
+  // the current scroll position
+  if (scrollShift != 0.0f)
+  {
+    mpTextWindow->Scroll.y -= scrollShift;
+    mSmoothScrollY = std::max(mSmoothScrollY - scrollShift, 0.0f);
+  }
+
   ImGui::EndChild();
 
   // Draw the button(s)
@@ -223,85 +360,373 @@ std::optional<int> View::draw(const ImVec2& windowSize)
 }
 
 
-bool View::fetchScriptOutput()
+bool View::fetchScriptOutput(const Clock::duration budget)
 {
   bool gotNewData = false;
 
-  // Check if there is new data available from the script's output
-  struct pollfd pollData{mScriptPipeFd, POLLIN, 0};
-  const auto result = poll(&pollData, 1, 0);
-
-  if (result > 0)
-  {
-    if (pollData.revents & POLLIN)
+  // When running the script again, the output is collected separately
+  // until the run is complete, see finishRun()
+  auto& text = mpRunText ? *mpRunText : mText;
+  auto pLineTimestamps =
+    mpRunText ? mpRunTimestamps.get() : mpLineTimestamps.get();
+
+  // Take over everything the reader thread has received so far, unless
+  // it's more than we can handle within our time budget. If there is
+  // more, it's picked up in the next frame.
+  const auto start = Clock::now();
+
+  const auto running = mpScriptReader->consumeOutput(
+    [&](
+      const std::string_view output,
+      const bool fromStderr,
+      const Clock::time_point arrivalTime)
     {
-      // Data is available.
-      char bytes[1024];
-      const auto bytesRead = read(mScriptPipeFd, bytes, sizeof(bytes));
-      if (bytesRead == -1)
+      gotNewData = true;
+      if (mpLogIndex)
       {
-        // Error reading the pipe
-        throw std::runtime_error("Error read()-ing script fd");
+        mpLogIndex->addOutput(
+          output, fromStderr, text, mOutputParser, mErrorOutputParser);
       }
 
-      if (bytesRead > 0)
-      {
-        gotNewData = true;
+      (fromStderr ? mErrorOutputParser : mOutputParser).parse(output);
+      stats().scriptBytesRead += output.size();
 
-        // We read some output bytes, append them to our message,
-        // taking word-wrapping into account as needed.
-        if (const auto pText = std::get_if<std::string>(&mText))
-        {
-          // Word-wrapping is disabled, simply append the bytes we read to our
-          // string.
-          pText->insert(pText->end(), bytes, bytes + bytesRead);
-        }
-        else if (const auto pLines = std::get_if<std::vector<std::string>>(&mText))
+      // Lines started by this output arrived together with it
+      if (pLineTimestamps)
+      {
+        const auto time = std::chrono::duration_cast<std::chrono::microseconds>(
+          arrivalTime - mpScriptReader->startTime());
+        while (pLineTimestamps->endLine() < text.endLine())
         {
-          // Word-wrapping is enabled, look for linebreaks and move on to
-          // the next line in the list of lines when we encouter one.
-          if (pLines->empty())
-          {
-            pLines->emplace_back(bytes, bytes + bytesRead);
-          }
-          else
-          {
-            for (auto pChar = bytes; pChar != bytes + bytesRead; ++pChar)
-            {
-              pLines->back().push_back(*pChar);
-
-              if (*pChar == '\n')
-              {
-                pLines->emplace_back();
-              }
-            }
-          }
+          pLineTimestamps->append(std::uint64_t(time.count()));
         }
       }
+    },
+    start + budget);
+
+  // Lines can only be restored from a complete log
+  if (mpLogIndex && mpScriptReader->logFailed())
+  {
+    mpLogIndex.reset();
+  }
+
+  // If dropped lines can be restored, their timestamps are kept for them
+  if (pLineTimestamps && !mpLogIndex)
+  {
+    pLineTimestamps->dropBefore(text.firstLine());
+  }
+
+  // The script is done, and we have all of its output
+  if (!running)
+  {
+    mpScriptReader.reset();
+
+    if (mpRunText)
+    {
+      finishRun();
+      gotNewData = true;
     }
 
-    if (pollData.revents & POLLHUP || pollData.revents & POLLERR)
+    if (mStartScript)
     {
-      // The script is done, or an error occured - close the pipe
-      closeScriptPipe();
+      mNextRunTime = Clock::now() + mRerunInterval;
+      wakeUpAfter(mRerunInterval);
     }
   }
-  else if (result < 0)
+
+  mScriptReadTime = Clock::now() - start;
+  stats().scriptReadMs +=
+    std::chrono::duration<double, std::milli>(mScriptReadTime).count();
+  return gotNewData;
+}
+
+
+// Lines dropped due to the scrollback limit are still in the log file.
+// When scrolling up to the first line we still have, we load some of the
+// previous ones again. They are dropped again once the view is back at
+// the bottom, so that memory use is only exceeded while looking at them.
+void View::restoreDroppedLines()
+{
+  const auto scrollY = mpTextWindow->Scroll.y;
+  const auto scrollMaxY = mpTextWindow->ScrollMax.y;
+
+  if (mLinesRestored && scrollMaxY > 0.0f && scrollY >= scrollMaxY)
   {
-    // Error polling the pipe
-    throw std::runtime_error("Error poll()-ing script fd");
+    mText.setLimits(mMaxLines, mMaxBytes);
+    mLinesRestored = false;
+    return;
   }
 
-  return gotNewData;
+  // Within a page of the top, and moving away from the bottom (or there's
+  // nothing to scroll)
+  const auto nearTop =
+    scrollY < mpTextWindow->InnerRect.GetHeight() &&
+    (scrollY < scrollMaxY || scrollMaxY == 0.0f);
+  if (mText.firstLine() == 0 || !nearTop)
+  {
+    return;
+  }
+
+  const auto previousFirstLine = mText.firstLine();
+  if (mpLogIndex->restoreLines(mText, linesRestoredAtOnce) == 0)
+  {
+    return;
+  }
+
+  mLinesRestored = true;
+
+  // registerNewGlyphs() only looks at the end of the text
+  if (mpGlyphCache)
+  {
+    for (auto i = mText.firstLine(); i < previousFirstLine; ++i)
+    {
+      mpGlyphCache->registerText(mText.line(i));
+    }
+  }
 }
 
 
-void View::closeScriptPipe()
+// With --interval, the script is run again periodically, like with watch.
+// The new output goes into a buffer of its own, so that the previous
+// output stays visible while the script is running.
+void View::startNextRun()
 {
-  if (mpScriptPipe)
+  mNextRunTime.reset();
+
+  mpRunText = std::make_unique<TextBuffer>();
+  mpRunText->setLimits(mMaxLines, mMaxBytes);
+  mOutputParser = AnsiParser{*mpRunText, 0};
+  mErrorOutputParser = AnsiParser{*mpRunText, TextBuffer::fromStderrFlag};
+
+  if (mpLineTimestamps)
+  {
+    mpRunTimestamps = std::make_unique<LineTimestamps>();
+  }
+
+  mpScriptReader = mStartScript();
+}
+
+
+// Once a run is complete, its output replaces the previous one. Lines
+// which are the same as before keep their layout and vertex data, only
+// the ones which changed are measured and rendered again. Those are also
+// highlighted for a moment.
+void View::finishRun()
+{
+  const auto previousRevision = mText.revision();
+  mText.replace(std::move(*mpRunText));
+  mpRunText.reset();
+  mOutputParser = AnsiParser{mText, 0};
+  mErrorOutputParser = AnsiParser{mText, TextBuffer::fromStderrFlag};
+
+  if (mpRunTimestamps)
+  {
+    mpLineTimestamps = std::move(mpRunTimestamps);
+  }
+
+  mChangedLinesRevision = previousRevision;
+  mHighlightEndTime = Clock::now() + changeHighlightDuration;
+  wakeUpAfter(changeHighlightDuration);
+
+  // registerNewGlyphs() only looks at the end of the text
+  if (mpGlyphCache)
   {
-    pclose(mpScriptPipe);
-    mpScriptPipe = nullptr;
-    mScriptPipeFd = -1;
+    for (auto i = mText.firstLine(); i < mText.endLine(); ++i)
+    {
+      if (mText.lineRevision(i) > previousRevision)
+      {
+        mpGlyphCache->registerText(mText.line(i));
+      }
+    }
+
+    mGlyphsRegisteredRevision = mText.revision();
   }
 }
+
+
+void View::drawChangeHighlights(const ImVec2& origin)
+{
+  if (mLayout.lineCount() == 0)
+  {
+    return;
+  }
+
+  auto& drawList = *ImGui::GetWindowDrawList();
+  const auto& clipRect = mpTextWindow->ClipRect;
+  const auto color = ImGui::GetColorU32(ImGuiCol_TextSelectedBg);
+
+  const auto first = mLayout.lineAt(clipRect.Min.y - origin.y);
+  const auto last = mLayout.lineAt(clipRect.Max.y - origin.y);
+  for (auto i = first; i <= last; ++i)
+  {
+    if (mText.lineRevision(i) > mChangedLinesRevision)
+    {
+      drawList.AddRectFilled(
+        {clipRect.Min.x, origin.y + mLayout.lineTop(i)},
+        {clipRect.Max.x, origin.y + mLayout.lineTop(i + 1)},
+        color);
+    }
+  }
+}
+
+
+// Nothing is rendered while idle, so anything due to happen later needs
+// to wake up the main loop
+void View::wakeUpAfter(const Clock::duration delay)
+{
+  // Rounded up, so that it's really time once we wake up
+  const auto milliseconds =
+    std::chrono::ceil<std::chrono::milliseconds>(delay).count() + 1;
+  SDL_AddTimer(
+    Uint32(milliseconds),
+    pushWakeupEvent,
+    reinterpret_cast<void*>(std::uintptr_t(mWakeupEventType)));
+}
+
+
+// Timestamps are shown in seconds since the script was started, with
+// millisecond precision. Returns the width needed for them, or 0 if they
+// aren't shown. Since times only ever increase, the last line's is the
+// widest, so the width doesn't change while scrolling.
+float View::lineTimestampsWidth() const
+{
+  if (!mpLineTimestamps)
+  {
+    return 0.0f;
+  }
+
+  char label[32];
+  formatLineTimestamp(label, sizeof(label), mpLineTimestamps->lastTime());
+  return ImGui::CalcTextSize(label).x + ImGui::GetStyle().ItemSpacing.x;
+}
+
+
+// Draws the timestamps of the visible lines, right-aligned within the
+// gutter
+void View::drawLineTimestamps(const ImVec2& origin, const float gutterWidth)
+{
+  if (mLayout.lineCount() == 0)
+  {
+    return;
+  }
+
+  auto& drawList = *ImGui::GetWindowDrawList();
+  const auto& clipRect = mpTextWindow->ClipRect;
+  const auto color = ImGui::GetColorU32(ImGuiCol_TextDisabled);
+  const auto spacing = ImGui::GetStyle().ItemSpacing.x;
+
+  const auto first = mLayout.lineAt(clipRect.Min.y - origin.y);
+  const auto last = mLayout.lineAt(clipRect.Max.y - origin.y);
+  for (auto i = first; i <= last; ++i)
+  {
+    if (!mpLineTimestamps->contains(i))
+    {
+      continue;
+    }
+
+    char label[32];
+    formatLineTimestamp(label, sizeof(label), mpLineTimestamps->get(i));
+    const auto labelWidth = ImGui::CalcTextSize(label).x;
+    drawList.AddText(
+      {origin.x + gutterWidth - spacing - labelWidth,
+       origin.y + mLayout.lineTop(i)},
+      color,
+      label);
+  }
+}
+
+
+void View::formatLineTimestamp(
+  char* pBuffer,
+  const std::size_t size,
+  const std::uint64_t microseconds)
+{
+  std::snprintf(
+    pBuffer,
+    size,
+    "%llu.%03llu",
+    static_cast<unsigned long long>(microseconds / 1000000),
+    static_cast<unsigned long long>(microseconds / 1000 % 1000));
+}
+
+
+// Dear ImGui scrolls by whole pixels when using the analog stick, which
+// makes slow scrolling stutter, or not move at all for small deflections.
+// While the stick is in use on the text, we therefore keep track of the
+// scroll position ourselves. The whole pixel part is handed to Dear ImGui,
+// so that the scrollbar etc. stay in sync. The remaining fraction is
+// returned, to be applied when drawing the text. Since the text renderer
+// positions text via a shader uniform, this doesn't cost anything extra.
+float View::updateSmoothScrolling()
+{
+  if (!mpTextWindow)
+  {
+    return 0.0f;
+  }
+
+  const auto& context = *ImGui::GetCurrentContext();
+  const auto& io = ImGui::GetIO();
+  const auto gamepadActive =
+    (io.ConfigFlags & ImGuiConfigFlags_NavEnableGamepad) &&
+    (io.BackendFlags & ImGuiBackendFlags_HasGamepad);
+
+  const auto stick =
+    gamepadActive &&
+    context.NavWindow == mpTextWindow &&
+    !context.NavWindowingTarget
+    ? ImGui::GetKeyData(ImGuiKey_GamepadLStickDown)->AnalogValue -
+      ImGui::GetKeyData(ImGuiKey_GamepadLStickUp)->AnalogValue
+    : 0.0f;
+
+  // Pick up changes made by anything else, like the scrollbar or
+  // auto-scrolling, and snap to whole pixels once the stick is released
+  if (stick == 0.0f || std::abs(mpTextWindow->Scroll.y - std::floor(mSmoothScrollY)) >= 1.0f)
+  {
+    mSmoothScrollY = mpTextWindow->Scroll.y;
+  }
+
+  if (stick == 0.0f)
+  {
+    return 0.0f;
+  }
+
+  // Same speed as Dear ImGui's own stick scrolling
+  const auto tweakFactor =
+    ImGui::IsKeyDown(ImGuiKey_NavGamepadTweakSlow) ? 1.0f / 10.0f :
+    ImGui::IsKeyDown(ImGuiKey_NavGamepadTweakFast) ? 10.0f :
+    1.0f;
+  const auto speed = mpTextWindow->CalcFontSize() * 100.0f * tweakFactor;
+
+  mSmoothScrollY = std::clamp(
+    mSmoothScrollY + stick * speed * io.DeltaTime,
+    0.0f,
+    mpTextWindow->ScrollMax.y);
+
+  // Overrides the scrolling done by Dear ImGui itself
+  const auto wholePixels = std::floor(mSmoothScrollY);
+  ImGui::SetNextWindowScroll({-1.0f, wholePixels});
+  return mSmoothScrollY - wholePixels;
+}
+
+
+void View::registerNewGlyphs()
+{
+  if (!mpGlyphCache || mText.revision() == mGlyphsRegisteredRevision)
+  {
+    return;
+  }
+
+  // Text is only ever added at the end, and only the last line is ever
+  // modified, so everything which changed is at the end
+  for (auto i = mText.endLine(); i > mText.firstLine(); --i)
+  {
+    if (mText.lineRevision(i - 1) <= mGlyphsRegisteredRevision)
+    {
+      break;
+    }
+
+    mpGlyphCache->registerText(mText.line(i - 1));
+  }
+
+  mGlyphsRegisteredRevision = mText.revision();
+}
@@ -21,36 +21,117 @@
 
 #pragma once
 
+#include "ansi_parser.hpp"
+#include "text_buffer.hpp"
+#include "text_layout.hpp"
+
 #include "imgui.h"
 
-#include <cstdio>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
 #include <optional>
-#include <variant>
-#include <vector>
+
+
+struct ImGuiWindow;
+class GlyphCache;
+class LineTimestamps;
+class LogIndex;
+class ScriptReader;
+class TextRenderer;
 
 
 class View {
 public:
+  using Clock = std::chrono::steady_clock;
+
   View(
+    TextRenderer& textRenderer,
+    GlyphCache* pGlyphCache,
     std::string windowTitle,
     std::string inputTextOrScriptFile,
     bool showYesNoButtons,
     bool wrapLines,
-    bool inpuTextIsScriptFile);
+    bool inpuTextIsScriptFile,
+    bool runScriptViaShell,
+    bool runScriptInPseudoterminal,
+    const std::string& logFile,
+    bool showLineTimestamps,
+    Clock::duration rerunInterval,
+    std::uint32_t scriptOutputEventType,
+    std::size_t maxLines,
+    std::size_t maxBytes);
   ~View();
 
-  std::optional<int> draw(const ImVec2& windowSize);
+  // At most scriptReadBudget is spent on taking in script output, see
+  // IngestScheduler
+  std::optional<int> draw(
+    const ImVec2& windowSize,
+    Clock::duration scriptReadBudget);
+
+  // Time spent on taking in script output during the last draw()
+  Clock::duration scriptReadTime() const { return mScriptReadTime; }
 
 private:
-  bool fetchScriptOutput();
-  void closeScriptPipe();
+  bool fetchScriptOutput(Clock::duration budget);
+  void registerNewGlyphs();
+  void restoreDroppedLines();
+  void startNextRun();
+  void finishRun();
+  void drawChangeHighlights(const ImVec2& origin);
+  void wakeUpAfter(Clock::duration delay);
+  float lineTimestampsWidth() const;
+  void drawLineTimestamps(const ImVec2& origin, float gutterWidth);
+  static void formatLineTimestamp(
+    char* pBuffer,
+    std::size_t size,
+    std::uint64_t microseconds);
+  float updateSmoothScrolling();
 
+  TextRenderer& mTextRenderer;
+  GlyphCache* mpGlyphCache;
   std::string mTitle;
-  std::variant<std::string, std::vector<std::string>> mText;
-  FILE* mpScriptPipe;
-  int mScriptPipeFd;
+  TextBuffer mText;
+
+  // Script output is meant for a terminal, and may contain colors etc.
+  AnsiParser mOutputParser;
+  AnsiParser mErrorOutputParser;
+  TextLayout mLayout;
+  std::uint32_t mGlyphsRegisteredRevision;
+
+  // The scrollable child window showing the text, and its vertical scroll
+  // position with sub-pixel precision
+  ImGuiWindow* mpTextWindow;
+  float mSmoothScrollY;
+  std::unique_ptr<ScriptReader> mpScriptReader;
+  Clock::duration mScriptReadTime;
+  std::uint32_t mWakeupEventType;
+
+  // When the script's output is written to a log file, lines dropped due
+  // to the scrollback limit are restored from it while they are looked at
+  std::unique_ptr<LogIndex> mpLogIndex;
+  std::size_t mMaxLines;
+  std::size_t mMaxBytes;
+  bool mLinesRestored;
+
+  // When each line arrived, if shown
+  std::unique_ptr<LineTimestamps> mpLineTimestamps;
+
+  // With a rerun interval, the script is started again that long after
+  // it finished. The output of the current run is collected here, and
+  // replaces the previous one once complete. Lines with a revision after
+  // mChangedLinesRevision changed in the last run.
+  Clock::duration mRerunInterval;
+  std::function<std::unique_ptr<ScriptReader>()> mStartScript;
+  std::optional<Clock::time_point> mNextRunTime;
+  std::unique_ptr<TextBuffer> mpRunText;
+  std::unique_ptr<LineTimestamps> mpRunTimestamps;
+  std::uint32_t mChangedLinesRevision;
+  Clock::time_point mHighlightEndTime;
 
   std::optional<int> mExitCode;
   bool mShowYesNoButtons;
+  bool mWrapLines;
 };